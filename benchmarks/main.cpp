@@ -0,0 +1,444 @@
+// Benchmarks for papki::file implementations.
+//
+// Usage: benchmarks [--quick] [--data-dir <path>]
+//
+// The benchmark generates test files and zip archives in the data directory
+// (by default 'papki_bench_data/' in the current directory), runs the
+// measurements and removes the generated data afterwards.
+//
+// Results are printed to stdout in CSV format, one line per measurement:
+// backend,operation,file_size,num_entries,iterations,ns_per_op,mb_per_s
+// The mb_per_s column is 0 for operations which do not transfer file data.
+//
+// Inflate engines are compared by loading entries of a deflated zip archive
+// residing in memory, the backend column holds "inflate_<engine name>" for these,
+// and the mb_per_s is given for the uncompressed data.
+
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <utki/debug.hpp>
+#include <utki/util.hpp>
+#include <zlib.h>
+
+#include "../src/papki/buffered_file.hpp"
+#include "../src/papki/fs_file.hpp"
+#include "../src/papki/inflate_engine.hpp"
+#include "../src/papki/mmap_file.hpp"
+#include "../src/papki/root_dir.hpp"
+#include "../src/papki/span_file.hpp"
+#include "../src/papki/vector_file.hpp"
+#include "../src/papki/zip_file.hpp"
+#include "../src/papki/zip_writer.hpp"
+
+namespace {
+struct config {
+	std::string data_dir = "papki_bench_data/";
+	std::vector<size_t> file_sizes = {0x1000, 0x100000, 0x1000000}; // 4kb, 1mb, 16mb
+	std::vector<size_t> entry_counts = {100, 10000};
+	std::chrono::nanoseconds min_duration = std::chrono::milliseconds(300);
+	size_t max_iterations = 100000;
+};
+
+config cfg;
+
+const size_t small_read_size = 64;
+const size_t large_read_size = 0x100000; // 1mb
+const size_t seek_stride = 0x1000; // 4kb
+const size_t async_read_size = 0x10000; // 64kb
+
+void print_header()
+{
+	std::cout << "backend,operation,file_size,num_entries,iterations,ns_per_op,mb_per_s" << std::endl;
+}
+
+// Runs the operation repeatedly until minimal duration or maximal number of iterations is reached,
+// and prints the result. The operation returns number of file data bytes it has transferred.
+void measure(
+	const std::string& backend,
+	const std::string& operation,
+	size_t file_size,
+	size_t num_entries,
+	const std::function<size_t()>& op
+)
+{
+	// warm up
+	op();
+
+	using clock = std::chrono::steady_clock;
+
+	size_t iterations = 0;
+	size_t num_bytes = 0;
+	auto start = clock::now();
+	auto elapsed = clock::duration::zero();
+	do {
+		num_bytes += op();
+		++iterations;
+		elapsed = clock::now() - start;
+	} while (elapsed < cfg.min_duration && iterations < cfg.max_iterations);
+
+	auto ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+
+	const double num_bytes_in_megabyte = 0x100000;
+	const double num_ns_in_second = 1e9;
+
+	std::cout << backend << ',' << operation << ',' << file_size << ',' << num_entries << ',' << iterations << ','
+			  << std::fixed << std::setprecision(1) << (ns / double(iterations)) << ','
+			  << (ns == 0 ? 0 : (double(num_bytes) / num_bytes_in_megabyte) / (ns / num_ns_in_second)) << std::endl;
+}
+
+std::vector<uint8_t> make_data(size_t size)
+{
+	std::vector<uint8_t> ret(size);
+	std::mt19937 gen(size);
+	for (auto& b : ret) {
+		b = uint8_t(gen());
+	}
+	return ret;
+}
+
+void write_file(const std::string& path, utki::span<const uint8_t> data)
+{
+	papki::fs_file f(path);
+	papki::file::guard file_guard(f, papki::mode::create);
+	f.write(data);
+}
+
+// Generates text-like data which compresses well, unlike make_data().
+std::vector<uint8_t> make_compressible_data(size_t size)
+{
+	const std::array<std::string_view, 8> words =
+		{"papki ", "zip ", "file ", "inflate ", "deflate ", "benchmark ", "data ", "entry\n"};
+
+	std::vector<uint8_t> ret;
+	ret.reserve(size);
+	std::mt19937 gen(size);
+	while (ret.size() != size) {
+		auto word = words[gen() % words.size()];
+		ret.insert(ret.end(), word.begin(), std::next(word.begin(), ptrdiff_t(std::min(word.size(), size - ret.size()))));
+	}
+	return ret;
+}
+
+std::string data_file_name(size_t size)
+{
+	return "data_" + std::to_string(size) + ".bin";
+}
+
+std::string entries_dir_name(size_t num_entries)
+{
+	return "entries_" + std::to_string(num_entries) + "/";
+}
+
+std::string entry_file_name(size_t i)
+{
+	return "file_" + std::to_string(i) + ".txt";
+}
+
+const std::string zip_file_name = "bench.zip";
+const std::string deflated_zip_file_name = "bench_deflated.zip";
+
+void generate_data()
+{
+	std::filesystem::remove_all(cfg.data_dir);
+	papki::fs_file(cfg.data_dir).make_dir();
+
+	papki::zip_writer zip(std::make_unique<papki::fs_file>(cfg.data_dir + zip_file_name));
+
+	for (auto size : cfg.file_sizes) {
+		auto data = make_data(size);
+		write_file(cfg.data_dir + data_file_name(size), data);
+		zip.add_entry(data_file_name(size), data, papki::zip_writer::method::store);
+	}
+
+	const std::string entry_content = "entry";
+
+	for (auto n : cfg.entry_counts) {
+		auto dir = entries_dir_name(n);
+		papki::fs_file(cfg.data_dir + dir).make_dir();
+		zip.add_entry(dir, {});
+		for (size_t i = 0; i != n; ++i) {
+			auto name = dir + entry_file_name(i);
+			write_file(cfg.data_dir + name, utki::to_uint8_t(utki::make_span(entry_content)));
+			zip.add_entry(name, utki::to_uint8_t(utki::make_span(entry_content)), papki::zip_writer::method::store);
+		}
+	}
+
+	zip.finish();
+
+	papki::zip_writer deflated_zip(std::make_unique<papki::fs_file>(cfg.data_dir + deflated_zip_file_name));
+	for (auto size : cfg.file_sizes) {
+		deflated_zip.add_entry(data_file_name(size), make_compressible_data(size));
+	}
+	deflated_zip.finish();
+}
+
+struct backend {
+	std::string name;
+
+	// creates file object, the paths are relative to the data directory
+	std::function<std::unique_ptr<papki::file>()> make;
+
+	// span_file and vector_file hold just one file of the benchmarked size
+	bool supports_dirs;
+};
+
+// the backends refer to the passed in data, so it has to outlive them
+std::vector<backend> make_backends(utki::span<const uint8_t> zip_data, utki::span<const uint8_t> largest_data)
+{
+	const auto& dir = cfg.data_dir;
+
+	return {
+		{"fs_file", [dir]() {
+			 return std::make_unique<papki::root_dir>(std::make_unique<papki::fs_file>(), dir);
+		 }, true},
+		{"fs_file_fd", [dir]() {
+			 return std::make_unique<papki::root_dir>(
+				 std::make_unique<papki::fs_file>(std::string_view(), papki::fs_file::access::fd),
+				 dir
+			 );
+		 }, true},
+		{"mmap_file", [dir]() {
+			 return std::make_unique<papki::root_dir>(std::make_unique<papki::mmap_file>(), dir);
+		 }, true},
+		{"buffered_file", [dir]() {
+			 return std::make_unique<papki::buffered_file>(
+				 std::make_unique<papki::root_dir>(std::make_unique<papki::fs_file>(), dir)
+			 );
+		 }, true},
+		{"zip_file", [dir]() {
+			 return std::make_unique<papki::zip_file>(std::make_unique<papki::fs_file>(dir + zip_file_name));
+		 }, true},
+		{"zip_file_in_memory", [zip_data]() {
+			 return std::make_unique<papki::zip_file>(std::make_unique<papki::span_file>(zip_data));
+		 }, true},
+		{"span_file", [largest_data]() {
+			 return std::make_unique<papki::span_file>(largest_data);
+		 }, false},
+		{"vector_file", [largest_data]() {
+			 auto f = std::make_unique<papki::vector_file>();
+			 papki::file::guard file_guard(*f, papki::mode::create);
+			 f->write(largest_data);
+			 return f;
+		 }, false}
+	};
+}
+
+size_t read_all(const papki::file& f, size_t chunk_size)
+{
+	std::vector<uint8_t> buf(chunk_size);
+	papki::file::guard file_guard(f);
+	size_t ret = 0;
+	for (;;) {
+		auto n = f.read(utki::make_span(buf));
+		ret += n;
+		if (n != buf.size()) {
+			return ret;
+		}
+	}
+}
+
+void run_file_benchmarks(const backend& b, size_t file_size)
+{
+	auto f = b.make();
+	if (b.supports_dirs) {
+		f->set_path(data_file_name(file_size));
+	}
+
+	measure(b.name, "load", file_size, 0, [&]() {
+		return f->load().size();
+	});
+
+	measure(b.name, "small_read", file_size, 0, [&]() {
+		return read_all(*f, small_read_size);
+	});
+
+	measure(b.name, "large_read", file_size, 0, [&]() {
+		return read_all(*f, large_read_size);
+	});
+
+	bool supports_read_at = true;
+	try {
+		papki::file::guard file_guard(*f);
+		std::array<uint8_t, 1> buf{};
+		f->read_at(0, utki::make_span(buf));
+	} catch (std::runtime_error&) {
+		supports_read_at = false;
+	}
+
+	if (supports_read_at) {
+		measure(b.name, "async_read", file_size, 0, [&]() {
+			std::vector<uint8_t> buf(file_size);
+			papki::file::guard file_guard(*f);
+
+			// issue all reads at once and wait for them
+			std::vector<std::future<size_t>> futures;
+			for (size_t offset = 0; offset < file_size; offset += async_read_size) {
+				futures.push_back(f->read_at_async(
+					offset,
+					utki::make_span(buf).subspan(offset, std::min(async_read_size, file_size - offset))
+				));
+			}
+
+			size_t ret = 0;
+			for (auto& future : futures) {
+				ret += future.get();
+			}
+			return ret;
+		});
+	}
+
+	measure(b.name, "seek", file_size, 0, [&]() {
+		papki::file::guard file_guard(*f);
+		while (f->seek_forward(seek_stride) == seek_stride) {
+		}
+		return size_t(0);
+	});
+
+	measure(b.name, "size", file_size, 0, [&]() {
+		if (f->size() != file_size) {
+			throw std::logic_error("wrong file size");
+		}
+		return size_t(0);
+	});
+}
+
+// Inflate engine which initializes new zlib stream for every call,
+// shows the gain of reusing the streams by zlib_inflate_engine.
+class zlib_no_reuse_inflate_engine : public papki::inflate_engine
+{
+public:
+	void inflate(utki::span<const uint8_t> compressed, utki::span<uint8_t> uncompressed) const override
+	{
+		z_stream strm{};
+		if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+			throw std::runtime_error("inflateInit2() failed");
+		}
+		utki::scope_exit strm_scope_exit([&strm]() {
+			inflateEnd(&strm);
+		});
+
+		std::array<uint8_t, 1> empty_output{};
+
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+		strm.next_in = const_cast<uint8_t*>(compressed.data());
+		strm.avail_in = uInt(compressed.size());
+		strm.next_out = uncompressed.empty() ? empty_output.data() : uncompressed.data();
+		strm.avail_out = uInt(uncompressed.size());
+
+		if (::inflate(&strm, Z_FINISH) != Z_STREAM_END || strm.avail_out != 0) {
+			throw std::runtime_error("inflating failed");
+		}
+	}
+};
+
+void run_inflate_benchmarks(utki::span<const uint8_t> deflated_zip_data, size_t file_size)
+{
+	const std::vector<std::pair<std::string, std::shared_ptr<const papki::inflate_engine>>> engines = {
+		{"zlib", papki::zlib_inflate_engine::get()},
+		{"zlib_no_reuse", std::make_shared<zlib_no_reuse_inflate_engine>()}
+	};
+
+	papki::zip_file f(std::make_unique<papki::span_file>(deflated_zip_data), data_file_name(file_size));
+
+	for (const auto& e : engines) {
+		f.set_inflate_engine(e.second);
+		measure("inflate_" + e.first, "load", file_size, 0, [&]() {
+			return f.load().size();
+		});
+	}
+
+	// reading in pieces does not use the inflate engine
+	measure("inflate_streaming", "large_read", file_size, 0, [&]() {
+		return read_all(f, large_read_size);
+	});
+}
+
+void run_dir_benchmarks(const backend& b, size_t num_entries)
+{
+	auto f = b.make();
+
+	f->set_path(entries_dir_name(num_entries));
+	measure(b.name, "list_dir", 0, num_entries, [&]() {
+		if (f->list_dir().size() != num_entries) {
+			throw std::logic_error("wrong number of directory entries");
+		}
+		return size_t(0);
+	});
+
+	measure(b.name, "list_dir_compact", 0, num_entries, [&]() {
+		if (f->list_dir_compact().size() != num_entries) {
+			throw std::logic_error("wrong number of directory entries");
+		}
+		return size_t(0);
+	});
+
+	std::mt19937 gen(num_entries);
+	measure(b.name, "exists", 0, num_entries, [&]() {
+		f->set_path(entries_dir_name(num_entries) + entry_file_name(gen() % num_entries));
+		if (!f->exists()) {
+			throw std::logic_error("entry does not exist");
+		}
+		return size_t(0);
+	});
+}
+} // namespace
+
+// NOLINTNEXTLINE(bugprone-exception-escape, "we want uncaught exceptions to fail the benchmark")
+int main(int argc, const char** argv)
+{
+	auto args = utki::make_span(argv, size_t(argc));
+	for (size_t i = 1; i < args.size(); ++i) {
+		std::string arg(args[i]);
+		if (arg == "--quick") {
+			cfg.file_sizes = {0x1000, 0x100000};
+			cfg.entry_counts = {100};
+			cfg.min_duration = std::chrono::milliseconds(20);
+		} else if (arg == "--data-dir" && i + 1 < args.size()) {
+			++i;
+			cfg.data_dir = papki::as_dir(args[i]);
+		} else {
+			std::cerr << "usage: benchmarks [--quick] [--data-dir <path>]" << std::endl;
+			return 1;
+		}
+	}
+
+	generate_data();
+
+	auto zip_data = papki::fs_file(cfg.data_dir + zip_file_name).load();
+	auto deflated_zip_data = papki::fs_file(cfg.data_dir + deflated_zip_file_name).load();
+
+	print_header();
+
+	for (auto size : cfg.file_sizes) {
+		auto data = make_data(size);
+		for (const auto& b : make_backends(utki::make_span(zip_data), utki::make_span(data))) {
+			run_file_benchmarks(b, size);
+		}
+	}
+
+	for (auto size : cfg.file_sizes) {
+		run_inflate_benchmarks(utki::make_span(deflated_zip_data), size);
+	}
+
+	for (auto n : cfg.entry_counts) {
+		for (const auto& b : make_backends(utki::make_span(zip_data), {})) {
+			if (b.supports_dirs) {
+				run_dir_benchmarks(b, n);
+			}
+		}
+	}
+
+	std::filesystem::remove_all(cfg.data_dir);
+
+	return 0;
+}
@@ -0,0 +1,275 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "buffered_file.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace papki;
+
+buffered_file::buffered_file(std::unique_ptr<file> base_file, size_t buffer_size) :
+	base_file(std::move(base_file)),
+	buffer(buffer_size)
+{
+	if (!this->base_file) {
+		throw std::invalid_argument("buffered_file(): passed in base file pointer is null");
+	}
+	if (buffer_size == 0) {
+		throw std::invalid_argument("buffered_file(): buffer size must not be zero");
+	}
+	this->file::set_path_internal(std::string(this->base_file->path()));
+}
+
+void buffered_file::open_internal(papki::mode io_mode)
+{
+	this->base_file->open(io_mode);
+	this->state = buffer_state::empty;
+	this->buf_pos = 0;
+	this->buf_end = 0;
+}
+
+void buffered_file::close_internal() const noexcept
+{
+	try {
+		this->flush();
+	} catch (std::exception& e) {
+		LOG([&](auto& o) {
+			o << "buffered_file::close(): flushing buffered data failed: " << e.what() << std::endl;
+		})
+	}
+	this->state = buffer_state::empty;
+	this->base_file->close();
+}
+
+void buffered_file::flush() const
+{
+	if (this->state != buffer_state::writing) {
+		return;
+	}
+
+	// reset the buffer before writing, so that the data is not written twice in case of error
+	auto num_bytes_to_write = this->buf_end;
+	this->state = buffer_state::empty;
+	this->buf_end = 0;
+
+	auto num_bytes_written = this->base_file->write(utki::make_span(this->buffer.data(), num_bytes_to_write));
+	if (num_bytes_written != num_bytes_to_write) {
+		throw std::runtime_error("buffered_file::flush(): could not write all buffered data");
+	}
+}
+
+void buffered_file::drop_read_buffer() const
+{
+	ASSERT(this->state == buffer_state::reading)
+	ASSERT(this->buf_pos <= this->buf_end)
+
+	auto num_unread_bytes = this->buf_end - this->buf_pos;
+
+	this->state = buffer_state::empty;
+	this->buf_pos = 0;
+	this->buf_end = 0;
+
+	if (num_unread_bytes != 0) {
+		this->base_file->seek_backward(num_unread_bytes);
+	}
+}
+
+void buffered_file::sync_base_position() const
+{
+	switch (this->state) {
+		case buffer_state::empty:
+			break;
+		case buffer_state::reading:
+			this->drop_read_buffer();
+			break;
+		case buffer_state::writing:
+			this->flush();
+			break;
+	}
+}
+
+size_t buffered_file::read_internal(utki::span<uint8_t> buf) const
+{
+	if (this->state == buffer_state::writing) {
+		this->flush();
+	}
+
+	size_t num_bytes_read = 0;
+
+	if (this->state == buffer_state::reading) {
+		ASSERT(this->buf_pos <= this->buf_end)
+		num_bytes_read = std::min(buf.size(), this->buf_end - this->buf_pos);
+		std::memcpy(buf.data(), &this->buffer[this->buf_pos], num_bytes_read);
+		this->buf_pos += num_bytes_read;
+
+		if (num_bytes_read == buf.size()) {
+			return num_bytes_read;
+		}
+
+		// the buffered data is exhausted
+		ASSERT(this->buf_pos == this->buf_end)
+		this->state = buffer_state::empty;
+	}
+
+	ASSERT(this->state == buffer_state::empty)
+
+	auto rest = buf.subspan(num_bytes_read);
+
+	if (rest.size() >= this->buffer.size()) {
+		// big request, read directly to the destination buffer
+		return num_bytes_read + this->base_file->read(rest);
+	}
+
+	this->buf_end = this->base_file->read(utki::make_span(this->buffer));
+	this->buf_pos = std::min(rest.size(), this->buf_end);
+	this->state = buffer_state::reading;
+
+	std::memcpy(rest.data(), this->buffer.data(), this->buf_pos);
+
+	return num_bytes_read + this->buf_pos;
+}
+
+size_t buffered_file::read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const
+{
+	// make buffered written data visible to the wrapped file
+	this->flush();
+
+	return this->base_file->read_at(offset, buf);
+}
+
+std::future<size_t> buffered_file::read_at_async_internal(uint64_t offset, utki::span<uint8_t> buf) const
+{
+	// make buffered written data visible to the wrapped file
+	this->flush();
+
+	return this->base_file->read_at_async(offset, buf);
+}
+
+size_t buffered_file::write_internal(utki::span<const uint8_t> buf)
+{
+	if (this->state == buffer_state::reading) {
+		this->drop_read_buffer();
+	}
+
+	if (this->state == buffer_state::empty) {
+		this->buf_end = 0;
+		this->state = buffer_state::writing;
+	}
+
+	ASSERT(this->state == buffer_state::writing)
+
+	if (this->buf_end + buf.size() > this->buffer.size()) {
+		this->flush();
+		ASSERT(this->buf_end == 0)
+
+		if (buf.size() >= this->buffer.size()) {
+			// big request, write directly to the wrapped file
+			return this->base_file->write(buf);
+		}
+
+		this->state = buffer_state::writing;
+	}
+
+	ASSERT(this->buf_end + buf.size() <= this->buffer.size())
+	std::memcpy(&this->buffer[this->buf_end], buf.data(), buf.size());
+	this->buf_end += buf.size();
+
+	return buf.size();
+}
+
+size_t buffered_file::seek_forward_internal(size_t num_bytes_to_seek) const
+{
+	if (this->state == buffer_state::reading) {
+		ASSERT(this->buf_pos <= this->buf_end)
+		auto num_unread_bytes = this->buf_end - this->buf_pos;
+		if (num_bytes_to_seek <= num_unread_bytes) {
+			this->buf_pos += num_bytes_to_seek;
+			return num_bytes_to_seek;
+		}
+
+		// skip all the buffered data, the wrapped file position is right after it
+		this->state = buffer_state::empty;
+		this->buf_pos = 0;
+		this->buf_end = 0;
+
+		return num_unread_bytes + this->base_file->seek_forward(num_bytes_to_seek - num_unread_bytes);
+	}
+
+	this->flush();
+
+	return this->base_file->seek_forward(num_bytes_to_seek);
+}
+
+size_t buffered_file::seek_backward_internal(size_t num_bytes_to_seek) const
+{
+	if (this->state == buffer_state::reading && num_bytes_to_seek <= this->buf_pos) {
+		this->buf_pos -= num_bytes_to_seek;
+		return num_bytes_to_seek;
+	}
+
+	this->sync_base_position();
+
+	return this->base_file->seek_backward(num_bytes_to_seek);
+}
+
+void buffered_file::rewind_internal() const
+{
+	this->flush();
+
+	this->state = buffer_state::empty;
+	this->buf_pos = 0;
+	this->buf_end = 0;
+
+	this->base_file->rewind();
+}
+
+uint64_t buffered_file::seek_internal(uint64_t position) const
+{
+	if (this->state == buffer_state::reading) {
+		// position of the wrapped file from where the buffered data was read
+		ASSERT(this->cur_pos() >= this->buf_pos)
+		uint64_t buf_begin = this->cur_pos() - this->buf_pos;
+		if (buf_begin <= position && position <= buf_begin + this->buf_end) {
+			this->buf_pos = size_t(position - buf_begin);
+			return position;
+		}
+	}
+
+	this->flush();
+
+	this->state = buffer_state::empty;
+	this->buf_pos = 0;
+	this->buf_end = 0;
+
+	return this->base_file->seek(position);
+}
+
+std::unique_ptr<file> buffered_file::spawn()
+{
+	return std::make_unique<buffered_file>(this->base_file->spawn(), this->buffer.size());
+}
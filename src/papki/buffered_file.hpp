@@ -0,0 +1,189 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <vector>
+
+#include <utki/config.hpp>
+
+#include "file.hpp"
+
+namespace papki {
+
+/**
+ * @brief Buffering wrapper over another file.
+ * Reads and writes done through this file are accumulated in a memory buffer,
+ * so that the wrapped file receives a small number of big read/write requests
+ * instead of a lot of small ones. It is useful when reading the file with small
+ * chunks, e.g. when parsing some binary format.
+ * The path of the buffered_file is the path of the wrapped file.
+ * Seeking backwards or writing after reading requires the wrapped file to
+ * support seeking backwards, unless the seek falls within the buffered data.
+ * Buffered written data is written to the wrapped file on flush(), seeking,
+ * rewinding, reading, or closing the file.
+ */
+class buffered_file : public file
+{
+	std::unique_ptr<file> base_file;
+
+	mutable std::vector<uint8_t> buffer;
+
+	// For reading: [0, buf_end) is the data read from the wrapped file, buf_pos is the position of the next byte to
+	// read. For writing: [0, buf_end) is the data to be written to the wrapped file.
+	mutable size_t buf_pos = 0;
+	mutable size_t buf_end = 0;
+
+	enum class buffer_state {
+		empty,
+		reading,
+		writing
+	};
+
+	mutable buffer_state state = buffer_state::empty;
+
+public:
+	constexpr static const size_t default_buffer_size = 0x10000; // 64kb
+
+	/**
+	 * @brief Constructor.
+	 * @param base_file - a file to wrap.
+	 * @param buffer_size - size of the memory buffer in bytes.
+	 */
+	buffered_file(std::unique_ptr<file> base_file, size_t buffer_size = default_buffer_size);
+
+	buffered_file(const buffered_file&) = delete;
+	buffered_file& operator=(const buffered_file&) = delete;
+
+	buffered_file(buffered_file&&) = delete;
+	buffered_file& operator=(buffered_file&&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * This destructor calls the close() method.
+	 */
+	~buffered_file() noexcept override
+	{
+		this->close();
+	}
+
+	/**
+	 * @brief Write buffered data to the wrapped file.
+	 * If the file is not opened or there is no buffered written data, then
+	 * nothing is done.
+	 */
+	void flush() const;
+
+	std::vector<std::string> list_dir(size_t max_entries = 0) const override
+	{
+		return this->base_file->list_dir(max_entries);
+	}
+
+	dir_listing list_dir_compact(size_t max_entries = std::numeric_limits<size_t>::max()) const override
+	{
+		return this->base_file->list_dir_compact(max_entries);
+	}
+
+	dir_entry_range dir_entries() const override
+	{
+		return this->base_file->dir_entries();
+	}
+
+	void make_dir() override
+	{
+		this->base_file->make_dir();
+	}
+
+	bool exists() const override
+	{
+		return this->base_file->exists();
+	}
+
+	uint64_t size() const override
+	{
+		return this->base_file->size();
+	}
+
+	std::unique_ptr<file> spawn() override;
+
+private:
+	void set_path_internal(std::string&& path_name) const override
+	{
+		this->base_file->set_path(path_name);
+		this->file::set_path_internal(std::move(path_name));
+	}
+
+	void open_internal(papki::mode io_mode) override;
+
+	void close_internal() const noexcept override;
+
+	size_t read_internal(utki::span<uint8_t> buf) const override;
+
+	size_t read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const override;
+
+	std::future<size_t> read_at_async_internal(uint64_t offset, utki::span<uint8_t> buf) const override;
+
+	size_t write_internal(utki::span<const uint8_t> buf) override;
+
+	size_t seek_forward_internal(size_t num_bytes_to_seek) const override;
+
+	size_t seek_backward_internal(size_t num_bytes_to_seek) const override;
+
+	void rewind_internal() const override;
+
+	uint64_t seek_internal(uint64_t position) const override;
+
+	std::optional<uint64_t> size_hint_internal() const override
+	{
+		return this->base_file->size_hint();
+	}
+
+	std::optional<utki::span<const uint8_t>> memory_view_internal() const override
+	{
+		// make buffered written data visible in the wrapped file
+		this->flush();
+		return this->base_file->memory_view();
+	}
+
+	void advise_internal(access_hint hint, uint64_t offset, uint64_t length) const override
+	{
+		this->base_file->advise(hint, offset, length);
+	}
+
+	void prefetch_internal(uint64_t offset, uint64_t length) const override
+	{
+		this->base_file->prefetch(offset, length);
+	}
+
+	// discard read buffer moving the wrapped file position to the current position of this file
+	void drop_read_buffer() const;
+
+	// flush written data or discard read data, so that the wrapped file position equals to this file position
+	void sync_base_position() const;
+};
+
+} // namespace papki
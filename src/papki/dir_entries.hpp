@@ -0,0 +1,237 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+#include <utki/debug.hpp>
+
+namespace papki {
+
+/**
+ * @brief Directory entry.
+ */
+struct dir_entry {
+	/**
+	 * @brief Name of the entry.
+	 * Names of subdirectories have trailing '/' character, same as returned by file::list_dir().
+	 */
+	std::string_view name;
+
+	/**
+	 * @brief Whether the entry is a subdirectory.
+	 */
+	bool is_dir = false;
+
+	/**
+	 * @brief Size of the file.
+	 * Only set in case the file system knows the size without doing extra requests.
+	 */
+	std::optional<uint64_t> size;
+
+	/**
+	 * @brief Whether the entry is a symbolic link.
+	 * For symbolic links is_dir tells whether the link target is a directory.
+	 */
+	bool is_symlink = false;
+};
+
+/**
+ * @brief Identity of a file within the file system.
+ * On POSIX systems it consists of device and inode numbers.
+ */
+struct file_id {
+	uint64_t device;
+	uint64_t inode;
+
+	bool operator==(const file_id& id) const noexcept
+	{
+		return this->device == id.device && this->inode == id.inode;
+	}
+
+	bool operator<(const file_id& id) const noexcept
+	{
+		return this->device < id.device || (this->device == id.device && this->inode < id.inode);
+	}
+};
+
+/**
+ * @brief Source of directory entries.
+ * Implementations read the directory entries one by one.
+ */
+class dir_reader
+{
+public:
+	dir_reader() = default;
+
+	dir_reader(const dir_reader&) = delete;
+	dir_reader& operator=(const dir_reader&) = delete;
+
+	dir_reader(dir_reader&&) = delete;
+	dir_reader& operator=(dir_reader&&) = delete;
+
+	virtual ~dir_reader() = default;
+
+	/**
+	 * @brief Read next directory entry.
+	 * The returned entry, including its name, is valid until next call to this function.
+	 * @return Next directory entry.
+	 * @return nullptr, if there are no more entries.
+	 */
+	virtual const dir_entry* next() = 0;
+
+	/**
+	 * @brief Get identity of the directory being read.
+	 * Default implementation returns std::nullopt.
+	 * @return Identity of the directory, if the file system identifies files.
+	 */
+	virtual std::optional<file_id> dir_id() const
+	{
+		return std::nullopt;
+	}
+};
+
+/**
+ * @brief Range of directory entries.
+ * The entries are read lazily, one by one, while iterating over the range.
+ * The range can be iterated only once.
+ */
+class dir_entry_range
+{
+	std::unique_ptr<dir_reader> reader;
+
+	const dir_entry* cur = nullptr;
+
+public:
+	/**
+	 * @brief Iterator over the directory entries.
+	 * This is an input iterator. Incrementing the iterator reads the next entry,
+	 * which invalidates the previous entry.
+	 */
+	class iterator
+	{
+		friend class dir_entry_range;
+
+		dir_entry_range* owner = nullptr;
+
+		iterator(dir_entry_range* owner) :
+			owner(owner)
+		{}
+
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = dir_entry;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const dir_entry*;
+		using reference = const dir_entry&;
+
+		iterator() = default;
+
+		const dir_entry& operator*() const
+		{
+			ASSERT(this->owner)
+			ASSERT(this->owner->cur)
+			return *this->owner->cur;
+		}
+
+		const dir_entry* operator->() const
+		{
+			return &this->operator*();
+		}
+
+		iterator& operator++()
+		{
+			ASSERT(this->owner)
+			this->owner->advance();
+			if (!this->owner->cur) {
+				this->owner = nullptr;
+			}
+			return *this;
+		}
+
+		bool operator==(const iterator& i) const noexcept
+		{
+			return this->owner == i.owner;
+		}
+
+		bool operator!=(const iterator& i) const noexcept
+		{
+			return !this->operator==(i);
+		}
+	};
+
+	/**
+	 * @brief Constructor.
+	 * @param reader - reader of the directory entries.
+	 */
+	dir_entry_range(std::unique_ptr<dir_reader> reader) :
+		reader(std::move(reader))
+	{}
+
+	/**
+	 * @brief Get iterator to the first entry.
+	 * Reads the first entry. Can be called only once.
+	 * @return Iterator to the first entry.
+	 */
+	iterator begin()
+	{
+		ASSERT(!this->cur)
+		this->advance();
+		if (!this->cur) {
+			return this->end();
+		}
+		return iterator(this);
+	}
+
+	iterator end() noexcept
+	{
+		return iterator();
+	}
+
+	/**
+	 * @brief Get identity of the directory.
+	 * It allows detecting that the same directory is reached via different paths, e.g. via symbolic links.
+	 * @return Identity of the directory, if the file system identifies files.
+	 */
+	std::optional<file_id> dir_id() const
+	{
+		return this->reader ? this->reader->dir_id() : std::nullopt;
+	}
+
+private:
+	void advance()
+	{
+		this->cur = this->reader ? this->reader->next() : nullptr;
+	}
+};
+
+} // namespace papki
@@ -0,0 +1,190 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <utki/debug.hpp>
+
+namespace papki {
+
+/**
+ * @brief List of directory entry names.
+ * All the names are stored one after another in a single memory buffer, so listing
+ * a big directory does not need a separate memory allocation for each entry.
+ * Names of subdirectories have trailing '/' character.
+ */
+class dir_listing
+{
+	std::string names;
+
+	// end positions of the names within the names buffer
+	std::vector<size_t> ends;
+
+public:
+	/**
+	 * @brief Iterator over the entry names.
+	 * Dereferencing the iterator gives a string view of the entry name.
+	 */
+	class const_iterator
+	{
+		friend class dir_listing;
+
+		const dir_listing* owner = nullptr;
+		size_t index = 0;
+
+		const_iterator(const dir_listing* owner, size_t index) :
+			owner(owner),
+			index(index)
+		{}
+
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = std::string_view;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const std::string_view*;
+		using reference = std::string_view;
+
+		const_iterator() = default;
+
+		std::string_view operator*() const
+		{
+			ASSERT(this->owner)
+			return (*this->owner)[this->index];
+		}
+
+		const_iterator& operator++()
+		{
+			++this->index;
+			return *this;
+		}
+
+		const_iterator operator++(int)
+		{
+			auto ret = *this;
+			++this->index;
+			return ret;
+		}
+
+		bool operator==(const const_iterator& i) const noexcept
+		{
+			return this->index == i.index && this->owner == i.owner;
+		}
+
+		bool operator!=(const const_iterator& i) const noexcept
+		{
+			return !this->operator==(i);
+		}
+	};
+
+	/**
+	 * @brief Reserve memory.
+	 * @param num_entries - number of entries to reserve memory for.
+	 * @param num_chars - total length of the entry names to reserve memory for.
+	 */
+	void reserve(size_t num_entries, size_t num_chars)
+	{
+		this->ends.reserve(num_entries);
+		this->names.reserve(num_chars);
+	}
+
+	/**
+	 * @brief Add entry name to the end of the list.
+	 * @param name - entry name to add.
+	 * @param is_dir - if true, then '/' is appended to the name, unless the name already ends with it.
+	 */
+	void push_back(std::string_view name, bool is_dir = false)
+	{
+		this->names.append(name);
+		if (is_dir && (name.empty() || name.back() != '/')) {
+			this->names.push_back('/');
+		}
+		this->ends.push_back(this->names.size());
+	}
+
+	/**
+	 * @brief Get number of entries.
+	 * @return Number of entries in the list.
+	 */
+	size_t size() const noexcept
+	{
+		return this->ends.size();
+	}
+
+	/**
+	 * @brief Check if the list is empty.
+	 * @return true - if the list has no entries.
+	 * @return false - otherwise.
+	 */
+	bool empty() const noexcept
+	{
+		return this->ends.empty();
+	}
+
+	/**
+	 * @brief Get entry name.
+	 * The returned string view is valid until the list is modified or destroyed.
+	 * @param i - index of the entry.
+	 * @return Name of the entry.
+	 */
+	std::string_view operator[](size_t i) const
+	{
+		ASSERT(i < this->ends.size())
+		size_t begin = i == 0 ? 0 : this->ends[i - 1];
+		return std::string_view(this->names).substr(begin, this->ends[i] - begin);
+	}
+
+	const_iterator begin() const noexcept
+	{
+		return const_iterator(this, 0);
+	}
+
+	const_iterator end() const noexcept
+	{
+		return const_iterator(this, this->size());
+	}
+
+	/**
+	 * @brief Convert to vector of strings.
+	 * @return Vector of entry names.
+	 */
+	std::vector<std::string> to_vector() const
+	{
+		std::vector<std::string> ret;
+		ret.reserve(this->size());
+		for (auto name : *this) {
+			ret.emplace_back(name);
+		}
+		return ret;
+	}
+};
+
+} // namespace papki
@@ -27,7 +27,9 @@ SOFTWARE.
 
 #include "file.hpp"
 
+#include <algorithm>
 #include <cstring>
+#include <limits>
 #include <list>
 
 using namespace papki;
@@ -82,6 +84,55 @@ std::vector<std::string> file::list_dir(size_t /* max_entries */) const
 	throw std::runtime_error("file::list_dir(): not supported for this file instance");
 }
 
+namespace {
+class listing_dir_reader : public dir_reader
+{
+	dir_listing listing;
+	size_t index = 0;
+	dir_entry entry;
+
+public:
+	listing_dir_reader(dir_listing&& listing) :
+		listing(std::move(listing))
+	{}
+
+	const dir_entry* next() override
+	{
+		if (this->index == this->listing.size()) {
+			return nullptr;
+		}
+
+		this->entry.name = this->listing[this->index];
+		this->entry.is_dir = papki::is_dir(this->entry.name);
+		++this->index;
+
+		return &this->entry;
+	}
+};
+} // namespace
+
+dir_entry_range file::dir_entries() const
+{
+	return dir_entry_range(std::make_unique<listing_dir_reader>(this->list_dir_compact()));
+}
+
+dir_listing file::list_dir_compact(size_t max_size) const
+{
+	auto entries = this->list_dir(max_size);
+
+	size_t num_chars = 0;
+	for (const auto& e : entries) {
+		num_chars += e.size();
+	}
+
+	dir_listing ret;
+	ret.reserve(entries.size(), num_chars);
+	for (const auto& e : entries) {
+		ret.push_back(e);
+	}
+	return ret;
+}
+
 size_t file::read(utki::span<uint8_t> buf) const
 {
 	if (!this->is_open()) {
@@ -98,6 +149,62 @@ size_t file::read_internal(utki::span<uint8_t> /* buf */) const
 	throw std::runtime_error("readInternal(): unsupported");
 }
 
+size_t file::read_at(uint64_t offset, utki::span<uint8_t> buf) const
+{
+	if (!this->is_open()) {
+		throw std::logic_error("Cannot read, file is not opened");
+	}
+
+	return this->read_at_internal(offset, buf);
+}
+
+size_t file::read_at_internal(uint64_t /* offset */, utki::span<uint8_t> /* buf */) const
+{
+	throw std::runtime_error("read_at(): unsupported");
+}
+
+std::future<size_t> file::read_at_async(uint64_t offset, utki::span<uint8_t> buf) const
+{
+	if (!this->is_open()) {
+		throw std::logic_error("Cannot read, file is not opened");
+	}
+
+	return this->read_at_async_internal(offset, buf);
+}
+
+std::future<size_t> file::read_at_async_internal(uint64_t offset, utki::span<uint8_t> buf) const
+{
+	std::promise<size_t> promise;
+	try {
+		promise.set_value(this->read_at_internal(offset, buf));
+	} catch (...) {
+		promise.set_exception(std::current_exception());
+	}
+	return promise.get_future();
+}
+
+void file::advise(access_hint hint, uint64_t offset, uint64_t length) const
+{
+	if (!this->is_open()) {
+		throw std::logic_error("advise(): file is not opened");
+	}
+
+	this->advise_internal(hint, offset, length);
+}
+
+void file::prefetch(uint64_t offset, uint64_t length) const
+{
+	if (!this->is_open()) {
+		throw std::logic_error("prefetch(): file is not opened");
+	}
+
+	if (length == 0) {
+		return;
+	}
+
+	this->prefetch_internal(offset, length);
+}
+
 size_t file::write(utki::span<const uint8_t> buf)
 {
 	if (!this->is_open()) {
@@ -167,6 +274,22 @@ size_t file::seek_backward_internal(size_t /* num_bytes_to_seek */) const
 	throw std::runtime_error("seek_backward() is unsupported");
 }
 
+std::optional<uint64_t> file::size_hint() const
+{
+	if (!this->is_open()) {
+		throw std::logic_error("size_hint(): file is not opened");
+	}
+	return this->size_hint_internal();
+}
+
+std::optional<utki::span<const uint8_t>> file::memory_view() const
+{
+	if (!this->is_open()) {
+		throw std::logic_error("memory_view(): file is not opened");
+	}
+	return this->memory_view_internal();
+}
+
 void file::make_dir()
 {
 	throw std::runtime_error("make_dir() is not supported");
@@ -189,6 +312,31 @@ void file::rewind_internal() const
 	const_cast<file*>(this)->open(m);
 }
 
+uint64_t file::seek(uint64_t position) const
+{
+	if (!this->is_open()) {
+		throw std::logic_error("seek(): file is not opened");
+	}
+	uint64_t ret = this->seek_internal(position);
+	this->current_pos = size_t(ret);
+	return ret;
+}
+
+uint64_t file::seek_internal(uint64_t position) const
+{
+	if (position < this->current_pos) {
+		this->rewind();
+	}
+
+	while (this->current_pos < position) {
+		auto num_bytes_to_seek = size_t(std::min(position - this->current_pos, uint64_t(std::numeric_limits<size_t>::max())));
+		if (this->seek_forward(num_bytes_to_seek) == 0) { // end of file reached
+			break;
+		}
+	}
+	return this->current_pos;
+}
+
 std::unique_ptr<file> file::spawn(std::string path)
 {
 	auto ret = this->spawn();
@@ -202,25 +350,53 @@ std::vector<uint8_t> file::load(size_t max_bytes_to_load) const
 		throw std::logic_error("file::load(): file should not be open");
 	}
 
+	file::guard file_guard(*this); // make sure we close the file upon exit from the function
+
+	return this->load_internal(max_bytes_to_load);
+}
+
+std::vector<uint8_t> file::load_internal(size_t max_bytes_to_load) const
+{
 	std::vector<uint8_t> ret;
 
-	file::guard file_guard(*this); // make sure we close the file upon exit from the function
+	size_t num_bytes_read = 0;
+
+	if (auto hint = this->size_hint(); hint.has_value()) {
+		// request one byte more than expected to detect end of file within the same read call
+		ret.resize(hint.value() < max_bytes_to_load ? size_t(hint.value()) + 1 : max_bytes_to_load);
 
-	const size_t read_chunk_size = 0x1000; // 4kb
+		num_bytes_read = this->read(utki::make_span(ret));
+		ASSERT(num_bytes_read <= ret.size())
 
-	for (size_t num_bytes_read = 0; max_bytes_to_load != 0; num_bytes_read += read_chunk_size) {
-		auto num_bytes_to_read = std::min(max_bytes_to_load, read_chunk_size);
-		ret.resize(ret.size() + num_bytes_to_read);
+		if (num_bytes_read != ret.size() || num_bytes_read == max_bytes_to_load) {
+			ret.resize(num_bytes_read);
+			return ret;
+		}
+
+		// the file has turned out to be bigger than expected, read the rest of it in chunks
+	}
+
+	const size_t min_read_chunk_size = 0x1000; // 4kb
+
+	while (num_bytes_read != max_bytes_to_load) {
+		ASSERT(num_bytes_read < max_bytes_to_load)
+
+		// grow the buffer geometrically
+		auto num_bytes_to_read =
+			std::min(max_bytes_to_load - num_bytes_read, std::max(min_read_chunk_size, num_bytes_read));
+
+		ret.resize(num_bytes_read + num_bytes_to_read);
 		auto n = this->read(utki::make_span(&ret[num_bytes_read], num_bytes_to_read));
 		ASSERT(n <= num_bytes_to_read)
+		num_bytes_read += n;
+
 		if (n != num_bytes_to_read) {
-			ret.resize(num_bytes_read + n);
-			return ret;
+			break;
 		}
-		ASSERT(max_bytes_to_load >= num_bytes_to_read)
-		max_bytes_to_load -= num_bytes_to_read;
 	}
 
+	ret.resize(num_bytes_read);
+
 	return ret;
 }
 
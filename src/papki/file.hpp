@@ -27,7 +27,9 @@ SOFTWARE.
 
 #pragma once
 
+#include <future>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
 
@@ -35,6 +37,8 @@ SOFTWARE.
 #include <utki/debug.hpp>
 #include <utki/span.hpp>
 
+#include "dir_entries.hpp"
+#include "dir_listing.hpp"
 #include "util.hpp"
 
 #ifdef assert
@@ -62,6 +66,32 @@ enum class mode {
 	create
 };
 
+/**
+ * @brief Hints about how the opened file is going to be accessed.
+ */
+enum class access_hint {
+	/**
+	 * @brief No special access pattern, use defaults.
+	 */
+	normal,
+	/**
+	 * @brief The data will be read sequentially, from lower offsets to higher ones.
+	 */
+	sequential,
+	/**
+	 * @brief The data will be read in random order.
+	 */
+	random,
+	/**
+	 * @brief The data will be read in the near future.
+	 */
+	will_need,
+	/**
+	 * @brief The data will not be read in the near future.
+	 */
+	dont_need
+};
+
 /**
  * @brief Abstract interface to a file system.
  * This class represents an abstract interface to a file system.
@@ -296,11 +326,31 @@ public:
 	 * @brief Get list of files and subdirectories of a directory.
 	 * If this file instance holds a path to a directory then this method
 	 * can be used to obtain the contents of the directory.
-	 * @param max_size - maximum size of the returned list.
+	 * @param max_size - maximum size of the returned list. 0 means no limit.
 	 * @return The array of string objects representing the directory entries.
 	 */
 	virtual std::vector<std::string> list_dir(size_t max_size = std::numeric_limits<size_t>::max()) const;
 
+	/**
+	 * @brief Get list of files and subdirectories of a directory.
+	 * Same as list_dir(), but the entry names are stored in a single memory buffer,
+	 * which is cheaper for directories with many entries.
+	 * Default implementation converts the result of list_dir().
+	 * @param max_size - maximum size of the returned list. 0 means no limit.
+	 * @return The list of directory entry names.
+	 */
+	virtual dir_listing list_dir_compact(size_t max_size = std::numeric_limits<size_t>::max()) const;
+
+	/**
+	 * @brief Iterate over files and subdirectories of a directory.
+	 * Same as list_dir(), but the entries are read lazily, one by one, while iterating
+	 * over the returned range, so there is no need to hold the whole listing in memory.
+	 * The file object must stay alive and its path must not change while iterating.
+	 * Default implementation iterates over the result of list_dir_compact().
+	 * @return Range of the directory entries.
+	 */
+	virtual dir_entry_range dir_entries() const;
+
 	/**
 	 * @brief Read data from file.
 	 * All sane file systems should support file reading.
@@ -325,6 +375,67 @@ protected:
 	 */
 	virtual size_t read_internal(utki::span<uint8_t> buf) const;
 
+public:
+	/**
+	 * @brief Read data from given position of the file.
+	 * Reads data starting from the given offset from the beginning of the file.
+	 * The current file position is not used and is not changed.
+	 * Implementations which support this operation allow calling it concurrently
+	 * from several threads on the same opened file object, as long as no other
+	 * operations are done on that file object at the same time.
+	 * Not all file systems support positional reading.
+	 * @param offset - position from the beginning of the file to read from.
+	 * @param buf - buffer where to store the read data.
+	 * @return Number of bytes actually read. Shall always be equal to number of
+	 * bytes requested to read except the case when end of file reached.
+	 * @throw std::logic_error - if file is not opened.
+	 */
+	size_t read_at(uint64_t offset, utki::span<uint8_t> buf) const;
+
+protected:
+	/**
+	 * @brief Read data from given position of the file, internal implementation.
+	 * This function is called by read_at() after it has done some safety checks.
+	 * Derived class may override this function with its own implementation.
+	 * The implementation must not change the current file position.
+	 * @param offset - position from the beginning of the file to read from.
+	 * @param buf - buffer to fill with read data.
+	 * @return number of bytes actually read.
+	 */
+	virtual size_t read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const;
+
+public:
+	/**
+	 * @brief Read data from given position of the file asynchronously.
+	 * Starts reading data from the given offset from the beginning of the file and
+	 * returns immediately, without waiting for the data. Many reads can be in flight
+	 * at the same time, for the same file or for different files.
+	 * The current file position is not used and is not changed.
+	 * The buffer must stay valid and the file must stay opened until the returned
+	 * future becomes ready.
+	 * File systems which do not support asynchronous reading perform the read
+	 * synchronously, before returning the future.
+	 * @param offset - position from the beginning of the file to read from.
+	 * @param buf - buffer where to store the read data.
+	 * @return Future which becomes ready when the read is complete. The future holds number of
+	 * bytes actually read, which is equal to number of bytes requested to read except the case
+	 * when end of file is reached. If reading fails, the future holds the exception.
+	 * @throw std::logic_error - if file is not opened.
+	 */
+	std::future<size_t> read_at_async(uint64_t offset, utki::span<uint8_t> buf) const;
+
+protected:
+	/**
+	 * @brief Read data from given position of the file asynchronously, internal implementation.
+	 * This function is called by read_at_async() after it has done some safety checks.
+	 * Derived class may override this function with its own implementation.
+	 * Default implementation calls read_at_internal() synchronously and returns ready future.
+	 * @param offset - position from the beginning of the file to read from.
+	 * @param buf - buffer to fill with read data.
+	 * @return Future holding number of bytes actually read.
+	 */
+	virtual std::future<size_t> read_at_async_internal(uint64_t offset, utki::span<uint8_t> buf) const;
+
 public:
 	/**
 	 * @brief Write data to file.
@@ -440,6 +551,135 @@ protected:
 	 */
 	virtual void rewind_internal() const;
 
+public:
+	/**
+	 * @brief Seek to absolute position.
+	 * Set file pointer to the given position from the beginning of the file.
+	 * It will not go beyond the end of file.
+	 * @param position - position to seek to.
+	 * @return resulting position.
+	 * @throw std::logic_error - if file is not opened.
+	 */
+	uint64_t seek(uint64_t position) const;
+
+protected:
+	/**
+	 * @brief Seek to absolute position, internal implementation.
+	 * This function is called by seek() after it has done some safety checks.
+	 * Derived class may override this function with its own implementation.
+	 * Default implementation seeks forward if the position is after the current one,
+	 * otherwise it rewinds the file and then seeks forward.
+	 * @param position - position to seek to.
+	 * @return resulting position.
+	 */
+	virtual uint64_t seek_internal(uint64_t position) const;
+
+public:
+	/**
+	 * @brief Get size of the opened file if it is cheaply available.
+	 * Some file systems can tell the file size from metadata without reading
+	 * the file contents. This information is used, for example, by load() to
+	 * allocate the memory buffer once.
+	 * @return Size of the opened file, if it is known.
+	 * @return std::nullopt, if file size cannot be obtained without reading the file.
+	 * @throw std::logic_error - if file is not opened.
+	 */
+	std::optional<uint64_t> size_hint() const;
+
+protected:
+	/**
+	 * @brief Get size of the opened file, internal implementation.
+	 * This function is called by size_hint() after it has done some safety checks.
+	 * Derived class may override this function with its own implementation.
+	 * Default implementation returns std::nullopt.
+	 * @return Size of the opened file, if it is known.
+	 */
+	virtual std::optional<uint64_t> size_hint_internal() const
+	{
+		return std::nullopt;
+	}
+
+public:
+	/**
+	 * @brief Get direct access to the contents of the opened file.
+	 * Files which reside in memory can give access to their contents without
+	 * copying the data.
+	 * The returned memory is valid until the file is closed or written to.
+	 * @return Span of the whole file contents, if the file supports direct access to it.
+	 * @return std::nullopt, if the file contents cannot be accessed directly.
+	 * @throw std::logic_error - if file is not opened.
+	 */
+	std::optional<utki::span<const uint8_t>> memory_view() const;
+
+protected:
+	/**
+	 * @brief Get direct access to the contents of the opened file, internal implementation.
+	 * This function is called by memory_view() after it has done some safety checks.
+	 * Derived class may override this function with its own implementation.
+	 * Default implementation returns std::nullopt.
+	 * @return Span of the whole file contents, if the file supports direct access to it.
+	 */
+	virtual std::optional<utki::span<const uint8_t>> memory_view_internal() const
+	{
+		return std::nullopt;
+	}
+
+public:
+	/**
+	 * @brief Give a hint about how the opened file is going to be accessed.
+	 * The hint allows the file system to optimize reading, e.g. to read ahead more
+	 * data for sequential access or to drop cached data which is not needed anymore.
+	 * The hint is purely advisory, it does not change the file contents or
+	 * semantics of any file operations. File systems which do not benefit from
+	 * the hints ignore them.
+	 * @param hint - access hint.
+	 * @param offset - offset from the beginning of the file of the data range the hint applies to.
+	 * @param length - length of the data range the hint applies to. 0 means till the end of the file.
+	 * @throw std::logic_error - if file is not opened.
+	 */
+	void advise(access_hint hint, uint64_t offset = 0, uint64_t length = 0) const;
+
+	/**
+	 * @brief Start loading the given data range of the opened file.
+	 * Tells the file system to start reading the given data range into cache, so that
+	 * subsequent reads of that range do not wait for the storage.
+	 * File systems which do not benefit from prefetching ignore it.
+	 * @param offset - offset from the beginning of the file of the data range to prefetch.
+	 * @param length - length of the data range to prefetch.
+	 * @throw std::logic_error - if file is not opened.
+	 */
+	void prefetch(uint64_t offset, uint64_t length) const;
+
+protected:
+	/**
+	 * @brief Give a hint about how the opened file is going to be accessed, internal implementation.
+	 * This function is called by advise() after it has done some safety checks.
+	 * Derived class may override this function with its own implementation.
+	 * Default implementation does nothing.
+	 * @param hint - access hint.
+	 * @param offset - offset from the beginning of the file of the data range the hint applies to.
+	 * @param length - length of the data range the hint applies to. 0 means till the end of the file.
+	 */
+	virtual void advise_internal(
+		access_hint /* hint */, //
+		uint64_t /* offset */,
+		uint64_t /* length */
+	) const
+	{}
+
+	/**
+	 * @brief Start loading the given data range of the opened file, internal implementation.
+	 * This function is called by prefetch() after it has done some safety checks.
+	 * Derived class may override this function with its own implementation.
+	 * Default implementation calls advise_internal() with access_hint::will_need.
+	 * @param offset - offset from the beginning of the file of the data range to prefetch.
+	 * @param length - length of the data range to prefetch.
+	 */
+	virtual void prefetch_internal(uint64_t offset, uint64_t length) const
+	{
+		this->advise_internal(access_hint::will_need, offset, length);
+	}
+
 public:
 	/**
 	 * @brief Create directory.
@@ -462,6 +702,21 @@ public:
 	 */
 	std::vector<uint8_t> load(size_t max_bytes_to_load = ~0) const;
 
+protected:
+	/**
+	 * @brief Load the entire file into the RAM, internal implementation.
+	 * This function is called by load() after it has opened the file for reading.
+	 * The file is closed by load() after this function returns.
+	 * Derived class may override this function with its own implementation, e.g. in case
+	 * the file contents can be obtained more efficiently than by reading the file.
+	 * Default implementation reads the file till its end.
+	 * @param max_bytes_to_load - maximum bytes to load.
+	 * @return Array containing loaded file data.
+	 */
+	virtual std::vector<uint8_t> load_internal(size_t max_bytes_to_load) const;
+
+public:
+
 	/**
 	 * @brief Check for file/directory existence.
 	 * @return true - if file/directory exists.
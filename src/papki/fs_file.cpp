@@ -32,17 +32,44 @@ SOFTWARE.
 #include <utki/util.hpp>
 
 #if CFG_OS == CFG_OS_WINDOWS
+#	include <sys/stat.h>
+#	include <sys/types.h>
+
 #	include <utki/windows.hpp>
 #elif CFG_OS == CFG_OS_LINUX || CFG_OS == CFG_OS_MACOSX || CFG_OS == CFG_OS_UNIX
 #	include <cerrno>
 #	include <cstring>
 
 #	include <dirent.h>
+#	include <fcntl.h>
 #	include <sys/stat.h>
+#	include <unistd.h>
 #endif
 
+#if CFG_OS == CFG_OS_LINUX && defined(__has_include)
+#	if __has_include(<linux/io_uring.h>)
+#		include <atomic>
+#		include <condition_variable>
+#		include <mutex>
+#		include <thread>
+#		include <unordered_set>
+
+#		include <linux/io_uring.h>
+#		include <sys/mman.h>
+#		include <sys/syscall.h>
+#		include <sys/uio.h>
+
+#		if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#			define PAPKI_IO_URING
+#		endif
+#	endif
+#endif
+
+#include <algorithm>
 #include <cstdlib>
+#include <limits>
 #include <sstream>
+#include <type_traits>
 #include <vector>
 
 // On iOS < 13.0 we use 'dirent' instead of std::filesystem, since std::filesystem
@@ -55,12 +82,538 @@ SOFTWARE.
 
 using namespace papki;
 
+namespace {
+// Size of regular file. Other files, like pipes or character devices, do not have meaningful size,
+// so std::nullopt is returned for them. Files in /proc and similar file systems are regular files
+// of zero size which still have contents, so zero size is only trusted if the file has just been truncated.
+std::optional<uint64_t> get_file_size(int fd, bool is_truncated)
+{
+	ASSERT(fd >= 0)
+
+#if CFG_OS == CFG_OS_WINDOWS
+	struct _stat64 file_stats;
+	if (_fstat64(fd, &file_stats) != 0) {
+		throw std::system_error(errno, std::generic_category(), "_fstat64() failed");
+	}
+#else
+	// clang-format off
+
+	struct stat file_stats{};
+
+	// clang-format on
+
+	if (fstat(fd, &file_stats) != 0) {
+		throw std::system_error(errno, std::generic_category(), "fstat() failed");
+	}
+#endif
+
+#if CFG_OS == CFG_OS_WINDOWS
+	if ((file_stats.st_mode & _S_IFMT) != _S_IFREG) {
+		return std::nullopt;
+	}
+#else
+	if (!S_ISREG(file_stats.st_mode)) {
+		return std::nullopt;
+	}
+#endif
+
+	if (file_stats.st_size == 0 && !is_truncated) {
+		return std::nullopt;
+	}
+	return uint64_t(file_stats.st_size);
+}
+
+#if CFG_OS != CFG_OS_WINDOWS
+size_t pread_all(int fd, utki::span<uint8_t> buf, uint64_t offset)
+{
+	size_t num_bytes_read = 0;
+	while (num_bytes_read != buf.size()) {
+		auto res = pread(
+			fd,
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+			buf.data() + num_bytes_read,
+			buf.size() - num_bytes_read,
+			off_t(offset + num_bytes_read)
+		);
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			throw std::system_error(errno, std::generic_category(), "pread() failed");
+		}
+		if (res == 0) { // end of file reached
+			break;
+		}
+		num_bytes_read += size_t(res);
+	}
+	return num_bytes_read;
+}
+
+void lseek_or_throw(int fd, off_t offset, int whence)
+{
+	if (lseek(fd, offset, whence) < 0) {
+		throw std::system_error(errno, std::generic_category(), "lseek() failed");
+	}
+}
+#endif
+
+#ifdef PAPKI_IO_URING
+// Asynchronous reader based on Linux io_uring.
+// A single ring is shared by all fs_file objects. Reads are submitted from the calling
+// threads and completions are collected by a dedicated thread which fulfills the promises.
+class io_ring
+{
+	constexpr static const unsigned num_entries = 256;
+
+	// largest read size which can be done by one read operation on Linux
+	constexpr static const size_t max_read_size = 0x7ffff000;
+
+	// user data of the request which wakes up the completion thread for quitting
+	constexpr static const uint64_t quit_user_data = 0;
+
+	struct request {
+		std::promise<size_t> promise;
+		int fd;
+		uint64_t offset;
+		utki::span<uint8_t> buf;
+		size_t num_bytes_read = 0;
+		iovec iov{};
+	};
+
+	int ring_fd = -1;
+
+	io_uring_params params{};
+
+	void* sq_ring = MAP_FAILED;
+	size_t sq_ring_size = 0;
+	void* cq_ring = MAP_FAILED;
+	size_t cq_ring_size = 0;
+	io_uring_sqe* sqes = nullptr;
+	size_t sqes_size = 0;
+
+	std::mutex mutex;
+	std::condition_variable cond_var;
+
+	// submitted requests which are not finished yet
+	std::unordered_set<request*> in_flight;
+
+	// set when the completion thread has quit because of io_uring failure
+	std::atomic<bool> is_failed = false;
+
+	std::thread completion_thread;
+
+	template <typename value_type>
+	value_type* sq_field(uint32_t offset) const
+	{
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		return reinterpret_cast<value_type*>(static_cast<uint8_t*>(this->sq_ring) + offset);
+	}
+
+	template <typename value_type>
+	value_type* cq_field(uint32_t offset) const
+	{
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		return reinterpret_cast<value_type*>(static_cast<uint8_t*>(this->cq_ring) + offset);
+	}
+
+	int enter(unsigned to_submit, unsigned min_complete, unsigned flags) const
+	{
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+		return int(syscall(__NR_io_uring_enter, this->ring_fd, to_submit, min_complete, flags, nullptr, 0));
+	}
+
+	// must be called with the mutex locked
+	void push(uint8_t opcode, request* r)
+	{
+		unsigned* tail_ptr = this->sq_field<unsigned>(this->params.sq_off.tail);
+		unsigned tail = *tail_ptr;
+		unsigned index = tail & *this->sq_field<unsigned>(this->params.sq_off.ring_mask);
+
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		io_uring_sqe& sqe = this->sqes[index];
+		std::memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = opcode;
+		sqe.fd = -1;
+
+		if (r) {
+			ASSERT(r->num_bytes_read < r->buf.size())
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+			r->iov.iov_base = r->buf.data() + r->num_bytes_read;
+			r->iov.iov_len = std::min(r->buf.size() - r->num_bytes_read, max_read_size);
+
+			sqe.fd = r->fd;
+			sqe.off = r->offset + r->num_bytes_read;
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			sqe.addr = reinterpret_cast<uint64_t>(&r->iov);
+			sqe.len = 1;
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			sqe.user_data = reinterpret_cast<uint64_t>(r);
+		} else {
+			sqe.user_data = quit_user_data;
+		}
+
+		this->sq_field<unsigned>(this->params.sq_off.array)[index] = index;
+
+		// make the filled entry visible to the kernel before the tail update
+		__atomic_store_n(tail_ptr, tail + 1, __ATOMIC_RELEASE);
+
+		for (;;) {
+			if (this->enter(1, 0, 0) >= 0) {
+				return;
+			}
+			if (errno == EINTR) {
+				continue;
+			}
+
+			int error = errno;
+
+			if (__atomic_load_n(this->sq_field<unsigned>(this->params.sq_off.head), __ATOMIC_ACQUIRE) != tail) {
+				// the entry was consumed by the kernel despite the error
+				return;
+			}
+
+			// the entry was not consumed by the kernel, remove it from the queue
+			__atomic_store_n(tail_ptr, tail, __ATOMIC_RELEASE);
+			throw std::system_error(error, std::generic_category(), "io_uring_enter() failed");
+		}
+	}
+
+	// returns true if the request is finished
+	bool handle_completion(request& r, int res)
+	{
+		if (res < 0) {
+			if (res == -EINTR || res == -EAGAIN) {
+				this->resubmit(r);
+				return false;
+			}
+			r.promise.set_exception(
+				std::make_exception_ptr(std::system_error(-res, std::generic_category(), "io_uring read failed"))
+			);
+			return true;
+		}
+
+		r.num_bytes_read += size_t(res);
+
+		if (res == 0 || r.num_bytes_read == r.buf.size()) {
+			r.promise.set_value(r.num_bytes_read);
+			return true;
+		}
+
+		// short read, read the rest
+		this->resubmit(r);
+		return false;
+	}
+
+	void resubmit(request& r)
+	{
+		try {
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->push(IORING_OP_READV, &r);
+		} catch (...) {
+			r.promise.set_exception(std::current_exception());
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->in_flight.erase(&r);
+			this->cond_var.notify_all();
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			delete &r;
+		}
+	}
+
+	// fail all unfinished requests, must be called with the mutex locked
+	void fail_in_flight(int error)
+	{
+		for (auto r : this->in_flight) {
+			r->promise.set_exception(
+				std::make_exception_ptr(std::system_error(error, std::generic_category(), "io_uring_enter() failed"))
+			);
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			delete r;
+		}
+		this->in_flight.clear();
+		this->cond_var.notify_all();
+	}
+
+	void run_completion_loop()
+	{
+		unsigned* head_ptr = this->cq_field<unsigned>(this->params.cq_off.head);
+		unsigned* tail_ptr = this->cq_field<unsigned>(this->params.cq_off.tail);
+		unsigned mask = *this->cq_field<unsigned>(this->params.cq_off.ring_mask);
+		auto cqes = this->cq_field<io_uring_cqe>(this->params.cq_off.cqes);
+
+		bool quit = false;
+
+		// requests finished within one iteration, there cannot be more of them than completion queue entries
+		std::vector<request*> finished;
+		finished.reserve(this->params.cq_entries);
+
+		for (;;) {
+			if (this->enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+				// the error is persistent, no completions can be collected anymore
+				int error = errno;
+				LOG([&](auto& o) {
+					o << "io_uring_enter() failed, fall back to synchronous reading: " << strerror(error) << std::endl;
+				})
+				std::lock_guard<std::mutex> lock(this->mutex);
+				this->is_failed = true;
+				this->fail_in_flight(error);
+				return;
+			}
+
+			finished.clear();
+
+			unsigned tail = 0;
+			{
+				// Requests are submitted under the same mutex lock, so reading the tail under the lock
+				// makes the request data written by the submitting threads visible to this thread.
+				std::lock_guard<std::mutex> lock(this->mutex);
+				tail = __atomic_load_n(tail_ptr, __ATOMIC_ACQUIRE);
+			}
+
+			unsigned head = *head_ptr;
+			for (; head != tail; ++head) {
+				// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+				const io_uring_cqe& cqe = cqes[head & mask];
+				if (cqe.user_data == quit_user_data) {
+					quit = true;
+					continue;
+				}
+
+				// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast, performance-no-int-to-ptr)
+				auto r = reinterpret_cast<request*>(cqe.user_data);
+				if (this->handle_completion(*r, cqe.res)) {
+					finished.push_back(r);
+				}
+			}
+
+			// free the processed completion queue entries
+			__atomic_store_n(head_ptr, head, __ATOMIC_RELEASE);
+
+			std::lock_guard<std::mutex> lock(this->mutex);
+			for (auto r : finished) {
+				this->in_flight.erase(r);
+				// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+				delete r;
+			}
+			if (!finished.empty()) {
+				this->cond_var.notify_all();
+			}
+			if (quit && this->in_flight.empty()) {
+				return;
+			}
+		}
+	}
+
+	void unmap() noexcept
+	{
+		if (this->sqes) {
+			munmap(this->sqes, this->sqes_size);
+		}
+		if (this->cq_ring != MAP_FAILED && this->cq_ring != this->sq_ring) {
+			munmap(this->cq_ring, this->cq_ring_size);
+		}
+		if (this->sq_ring != MAP_FAILED) {
+			munmap(this->sq_ring, this->sq_ring_size);
+		}
+		::close(this->ring_fd);
+	}
+
+public:
+	io_ring()
+	{
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+		this->ring_fd = int(syscall(__NR_io_uring_setup, num_entries, &this->params));
+		if (this->ring_fd < 0) {
+			throw std::system_error(errno, std::generic_category(), "io_uring_setup() failed");
+		}
+
+		try {
+			this->sq_ring_size = this->params.sq_off.array + this->params.sq_entries * sizeof(unsigned);
+			this->cq_ring_size = this->params.cq_off.cqes + this->params.cq_entries * sizeof(io_uring_cqe);
+
+			bool single_mmap = (this->params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+			if (single_mmap) {
+				this->sq_ring_size = std::max(this->sq_ring_size, this->cq_ring_size);
+			}
+
+			this->sq_ring = mmap(
+				nullptr,
+				this->sq_ring_size,
+				PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE,
+				this->ring_fd,
+				IORING_OFF_SQ_RING
+			);
+			if (this->sq_ring == MAP_FAILED) {
+				throw std::system_error(errno, std::generic_category(), "mmap() failed");
+			}
+
+			if (single_mmap) {
+				this->cq_ring = this->sq_ring;
+			} else {
+				this->cq_ring = mmap(
+					nullptr,
+					this->cq_ring_size,
+					PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_POPULATE,
+					this->ring_fd,
+					IORING_OFF_CQ_RING
+				);
+				if (this->cq_ring == MAP_FAILED) {
+					throw std::system_error(errno, std::generic_category(), "mmap() failed");
+				}
+			}
+
+			this->sqes_size = this->params.sq_entries * sizeof(io_uring_sqe);
+			void* sqes_ptr = mmap(
+				nullptr,
+				this->sqes_size,
+				PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE,
+				this->ring_fd,
+				IORING_OFF_SQES
+			);
+			if (sqes_ptr == MAP_FAILED) {
+				throw std::system_error(errno, std::generic_category(), "mmap() failed");
+			}
+			this->sqes = static_cast<io_uring_sqe*>(sqes_ptr);
+
+			this->completion_thread = std::thread([this]() {
+				this->run_completion_loop();
+			});
+		} catch (...) {
+			this->unmap();
+			throw;
+		}
+	}
+
+	io_ring(const io_ring&) = delete;
+	io_ring& operator=(const io_ring&) = delete;
+
+	io_ring(io_ring&&) = delete;
+	io_ring& operator=(io_ring&&) = delete;
+
+	~io_ring()
+	{
+		if (!this->is_failed) {
+			std::lock_guard<std::mutex> lock(this->mutex);
+			try {
+				this->push(IORING_OP_NOP, nullptr);
+			} catch (std::system_error& e) {
+				ASSERT(false, [&](auto& o) {
+					o << "io_ring::~io_ring(): waking up completion thread failed: " << e.what();
+				})
+			}
+		}
+		this->completion_thread.join();
+		this->unmap();
+	}
+
+	std::future<size_t> read(int fd, uint64_t offset, utki::span<uint8_t> buf)
+	{
+		// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+		auto r = new request{std::promise<size_t>(), fd, offset, buf};
+		auto ret = r->promise.get_future();
+
+		std::unique_lock<std::mutex> lock(this->mutex);
+
+		// Limit number of requests in flight, so that completion queue never overflows.
+		// The completion queue is at least as big as the submission queue.
+		this->cond_var.wait(lock, [this]() {
+			return this->in_flight.size() < this->params.sq_entries;
+		});
+
+		try {
+			if (this->is_failed) {
+				throw std::system_error(EIO, std::generic_category(), "io_ring::read(): io_uring has failed");
+			}
+
+			// the completion thread removes the request under the same mutex lock,
+			// so it is ok to add it before the request is submitted
+			auto i = this->in_flight.insert(r).first;
+			try {
+				this->push(IORING_OP_READV, r);
+			} catch (...) {
+				this->in_flight.erase(i);
+				throw;
+			}
+		} catch (...) {
+			// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+			delete r;
+			throw;
+		}
+
+		return ret;
+	}
+
+	bool has_failed() const noexcept
+	{
+		return this->is_failed;
+	}
+
+	// returns nullptr if io_uring is not available
+	static io_ring* inst()
+	{
+		static const std::unique_ptr<io_ring> instance = []() -> std::unique_ptr<io_ring> {
+			try {
+				return std::make_unique<io_ring>();
+			} catch (std::system_error& e) {
+				LOG([&](auto& o) {
+					o << "io_uring is not available, fall back to synchronous reading: " << e.what() << std::endl;
+				})
+				return nullptr;
+			}
+		}();
+		return instance.get();
+	}
+};
+#endif
+} // namespace
+
 void fs_file::open_internal(papki::mode mode)
 {
 	if (this->is_dir()) {
 		throw std::logic_error("path refers to a directory, directories can't be opened");
 	}
 
+#if CFG_OS != CFG_OS_WINDOWS
+	if (this->file_access == access::fd) {
+		int flags = [&mode]() {
+			switch (mode) {
+				case papki::mode::write:
+					return O_RDWR;
+				case papki::mode::create:
+					return O_RDWR | O_CREAT | O_TRUNC;
+				case papki::mode::read:
+					return O_RDONLY;
+				default:
+					throw std::invalid_argument("unknown mode");
+			}
+		}();
+
+		const mode_t permissions = 0666; // same as fopen() uses, before applying umask
+
+		do {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+			this->fd = ::open(this->path().c_str(), flags | O_CLOEXEC, permissions);
+		} while (this->fd < 0 && errno == EINTR);
+
+		if (this->fd < 0) {
+			std::stringstream ss;
+			ss << "open(" << this->path().c_str() << ") failed";
+			throw std::system_error(errno, std::generic_category(), ss.str());
+		}
+
+		try {
+			this->file_size = get_file_size(this->fd, mode == papki::mode::create);
+		} catch (...) {
+			::close(this->fd);
+			this->fd = -1;
+			throw;
+		}
+		return;
+	}
+#endif
+
 	const char* mode_str = [&mode]() {
 		switch (mode) {
 			case papki::mode::write:
@@ -90,10 +643,29 @@ void fs_file::open_internal(papki::mode mode)
 		ss << "fopen(" << this->path().c_str() << ") failed";
 		throw std::system_error(errno, std::generic_category(), ss.str());
 	}
+
+	try {
+		this->file_size = get_file_size(fileno(this->handle), mode == papki::mode::create);
+	} catch (...) {
+		// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+		fclose(this->handle);
+		this->handle = nullptr;
+		throw;
+	}
 }
 
 void fs_file::close_internal() const noexcept
 {
+	this->file_size.reset();
+
+	if (this->fd >= 0) {
+#if CFG_OS != CFG_OS_WINDOWS
+		::close(this->fd);
+#endif
+		this->fd = -1;
+		return;
+	}
+
 	ASSERT(this->handle)
 
 	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
@@ -103,6 +675,27 @@ void fs_file::close_internal() const noexcept
 
 size_t fs_file::read_internal(utki::span<uint8_t> buf) const
 {
+#if CFG_OS != CFG_OS_WINDOWS
+	if (this->fd >= 0) {
+		size_t num_bytes_read = 0;
+		while (num_bytes_read != buf.size()) {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+			auto res = ::read(this->fd, buf.data() + num_bytes_read, buf.size() - num_bytes_read);
+			if (res < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw std::system_error(errno, std::generic_category(), "read() failed");
+			}
+			if (res == 0) { // end of file reached
+				break;
+			}
+			num_bytes_read += size_t(res);
+		}
+		return num_bytes_read;
+	}
+#endif
+
 	ASSERT(this->handle)
 	size_t num_bytes_read = fread(buf.begin(), 1, buf.size(), this->handle);
 	if (num_bytes_read != buf.size()) { // something happened
@@ -113,19 +706,144 @@ size_t fs_file::read_internal(utki::span<uint8_t> buf) const
 	return num_bytes_read;
 }
 
-size_t fs_file::write_internal(utki::span<const uint8_t> buf)
+size_t fs_file::read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const
 {
+#if CFG_OS != CFG_OS_WINDOWS
+	if (this->fd >= 0) {
+		return pread_all(this->fd, buf, offset);
+	}
+#endif
+
 	ASSERT(this->handle)
-	size_t bytes_written = fwrite(buf.begin(), 1, buf.size(), this->handle);
-	if (bytes_written != buf.size()) { // something bad has happened
-		throw std::runtime_error("fwrite error");
+
+	if (this->io_mode == papki::mode::write) {
+		// make the data buffered by stdio visible to positional reads
+		if (fflush(this->handle) != 0) {
+			throw std::system_error(errno, std::generic_category(), "fflush() failed");
+		}
+	}
+
+#if CFG_OS == CFG_OS_WINDOWS
+	// Windows has no positional read which would leave the file pointer intact,
+	// so move the file pointer under the FILE lock and restore it afterwards.
+	_lock_file(this->handle);
+	utki::scope_exit unlock_scope_exit([this]() {
+		_unlock_file(this->handle);
+	});
+
+	auto pos = _ftelli64_nolock(this->handle);
+	if (pos < 0) {
+		throw std::runtime_error("_ftelli64() failed");
+	}
+
+	if (_fseeki64_nolock(this->handle, int64_t(offset), SEEK_SET) != 0) {
+		throw std::runtime_error("_fseeki64() failed");
+	}
+
+	size_t num_bytes_read = _fread_nolock(buf.data(), 1, buf.size(), this->handle);
+	bool failed = num_bytes_read != buf.size() && ferror(this->handle);
+
+	if (_fseeki64_nolock(this->handle, pos, SEEK_SET) != 0) {
+		throw std::runtime_error("_fseeki64() failed");
+	}
+
+	if (failed) {
+		throw std::runtime_error("fread() error");
+	}
+
+	return num_bytes_read;
+#else
+	return pread_all(fileno(this->handle), buf, offset);
+#endif
+}
+
+size_t fs_file::write_internal(utki::span<const uint8_t> buf)
+{
+	size_t bytes_written = 0;
+
+#if CFG_OS != CFG_OS_WINDOWS
+	if (this->fd >= 0) {
+		while (bytes_written != buf.size()) {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+			auto res = ::write(this->fd, buf.data() + bytes_written, buf.size() - bytes_written);
+			if (res < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw std::system_error(errno, std::generic_category(), "write() failed");
+			}
+			bytes_written += size_t(res);
+		}
+	} else
+#endif
+	{
+		ASSERT(this->handle)
+		bytes_written = fwrite(buf.begin(), 1, buf.size(), this->handle);
+		if (bytes_written != buf.size()) { // something bad has happened
+			throw std::runtime_error("fwrite error");
+		}
+	}
+
+	if (this->file_size) {
+		this->file_size = std::max(this->file_size.value(), uint64_t(this->cur_pos()) + bytes_written);
 	}
 
 	return bytes_written;
 }
 
+size_t fs_file::seek_forward_internal(size_t num_bytes_to_seek) const
+{
+	if (!this->file_size) {
+		// the file is not a regular file, it might not support seeking, so read it forward
+		return this->file::seek_forward_internal(num_bytes_to_seek);
+	}
+
+	const auto file_size = this->file_size.value();
+	if (this->cur_pos() >= file_size) {
+		// the file could have been truncated by someone else
+		return 0;
+	}
+
+	num_bytes_to_seek = size_t(std::min(uint64_t(num_bytes_to_seek), file_size - this->cur_pos())); // clamp top
+
+	if (num_bytes_to_seek == 0) {
+		return 0;
+	}
+
+#if CFG_OS != CFG_OS_WINDOWS
+	if (this->fd >= 0) {
+		lseek_or_throw(this->fd, off_t(this->cur_pos() + num_bytes_to_seek), SEEK_SET);
+		return num_bytes_to_seek;
+	}
+#endif
+
+	ASSERT(this->handle)
+
+#if CFG_OS == CFG_OS_WINDOWS
+	if (_fseeki64(this->handle, int64_t(num_bytes_to_seek), SEEK_CUR) != 0) {
+		throw std::runtime_error("_fseeki64() failed");
+	}
+#else
+	static_assert(sizeof(off_t) >= sizeof(uint32_t), "off_t is too small");
+	ASSERT(uint64_t(num_bytes_to_seek) <= uint64_t(std::numeric_limits<off_t>::max()))
+	if (fseeko(this->handle, off_t(num_bytes_to_seek), SEEK_CUR) != 0) {
+		throw std::runtime_error("fseeko() failed");
+	}
+#endif
+
+	return num_bytes_to_seek;
+}
+
 size_t fs_file::seek_backward_internal(size_t num_bytes_to_seek) const
 {
+#if CFG_OS != CFG_OS_WINDOWS
+	if (this->fd >= 0) {
+		num_bytes_to_seek = std::min(num_bytes_to_seek, this->cur_pos()); // clamp top
+		lseek_or_throw(this->fd, off_t(this->cur_pos() - num_bytes_to_seek), SEEK_SET);
+		return num_bytes_to_seek;
+	}
+#endif
+
 	ASSERT(this->handle)
 
 	// NOTE: fseek() accepts 'long int' as offset argument which is signed and can
@@ -173,12 +891,126 @@ void fs_file::rewind_internal() const
 		throw std::logic_error("cannot rewind, file is not opened");
 	}
 
+#if CFG_OS != CFG_OS_WINDOWS
+	if (this->fd >= 0) {
+		lseek_or_throw(this->fd, 0, SEEK_SET);
+		return;
+	}
+#endif
+
 	ASSERT(this->handle)
 	if (fseek(this->handle, 0, SEEK_SET) != 0) {
 		throw std::runtime_error("fseek() failed");
 	}
 }
 
+uint64_t fs_file::seek_internal(uint64_t position) const
+{
+	if (!this->is_open()) {
+		throw std::logic_error("cannot seek, file is not opened");
+	}
+
+	if (!this->file_size) {
+		// the file is not a regular file, it might not support seeking
+		return this->file::seek_internal(position);
+	}
+
+	position = std::min(position, this->file_size.value()); // clamp top
+
+#if CFG_OS != CFG_OS_WINDOWS
+	if (this->fd >= 0) {
+		lseek_or_throw(this->fd, off_t(position), SEEK_SET);
+		return position;
+	}
+#endif
+
+	ASSERT(this->handle)
+
+#if CFG_OS == CFG_OS_WINDOWS
+	if (_fseeki64(this->handle, int64_t(position), SEEK_SET) != 0) {
+		throw std::runtime_error("_fseeki64() failed");
+	}
+#else
+	ASSERT(position <= uint64_t(std::numeric_limits<off_t>::max()))
+	if (fseeko(this->handle, off_t(position), SEEK_SET) != 0) {
+		throw std::runtime_error("fseeko() failed");
+	}
+#endif
+
+	return position;
+}
+
+std::optional<uint64_t> fs_file::size_hint_internal() const
+{
+	return this->file_size;
+}
+
+std::future<size_t> fs_file::read_at_async_internal(uint64_t offset, utki::span<uint8_t> buf) const
+{
+#ifdef PAPKI_IO_URING
+	if (auto ring = io_ring::inst(); ring && !ring->has_failed()) {
+		if (buf.empty()) {
+			std::promise<size_t> promise;
+			promise.set_value(0);
+			return promise.get_future();
+		}
+
+		int fd = this->fd;
+		if (fd < 0) {
+			ASSERT(this->handle)
+			if (this->io_mode == papki::mode::write) {
+				// make the data buffered by stdio visible to positional reads
+				if (fflush(this->handle) != 0) {
+					throw std::system_error(errno, std::generic_category(), "fflush() failed");
+				}
+			}
+			fd = fileno(this->handle);
+		}
+
+		return ring->read(fd, offset, buf);
+	}
+#endif
+
+	return this->file::read_at_async_internal(offset, buf);
+}
+
+void fs_file::advise_internal(access_hint hint, uint64_t offset, uint64_t length) const
+{
+#if CFG_OS == CFG_OS_LINUX
+	int advice = [&hint]() {
+		switch (hint) {
+			case access_hint::sequential:
+				return POSIX_FADV_SEQUENTIAL;
+			case access_hint::random:
+				return POSIX_FADV_RANDOM;
+			case access_hint::will_need:
+				return POSIX_FADV_WILLNEED;
+			case access_hint::dont_need:
+				return POSIX_FADV_DONTNEED;
+			default:
+				return POSIX_FADV_NORMAL;
+		}
+	}();
+
+	int fd = this->fd >= 0 ? this->fd : fileno(this->handle);
+
+	// the hint is advisory, so errors are ignored
+	posix_fadvise(fd, off_t(offset), off_t(length), advice);
+#endif
+}
+
+void fs_file::prefetch_internal(uint64_t offset, uint64_t length) const
+{
+#if CFG_OS == CFG_OS_LINUX
+	int fd = this->fd >= 0 ? this->fd : fileno(this->handle);
+
+	// readahead() is advisory, so errors are ignored
+	readahead(fd, off64_t(offset), size_t(std::min(length, uint64_t(std::numeric_limits<size_t>::max()))));
+#else
+	this->advise_internal(access_hint::will_need, offset, length);
+#endif
+}
+
 bool fs_file::exists() const
 {
 	if (this->is_open()) { // file is opened => it exists
@@ -286,41 +1118,226 @@ std::string fs_file::get_home_dir()
 	return ret;
 }
 
-std::vector<std::string> fs_file::list_dir(size_t max_size) const
+namespace {
+#if CFG_OS == CFG_OS_LINUX || CFG_OS == CFG_OS_MACOSX || CFG_OS == CFG_OS_UNIX
+// On POSIX systems the directory is read via 'dirent.h' directly. The entry type is
+// taken from the d_type field filled by readdir(), so there is no stat() call per entry,
+// except for symbolic links and file systems which do not report entry types.
+class posix_dir_reader : public dir_reader
 {
-	if (!this->is_dir()) {
-		throw std::logic_error("fs_file::list_dir(): this is not a directory");
+	DIR* pdir;
+
+	std::string name;
+	dir_entry entry;
+
+public:
+	posix_dir_reader(const std::string& path) :
+		pdir(opendir(path.c_str()))
+	{
+		if (!this->pdir) {
+			std::stringstream ss;
+			ss << "fs_file::list_dir(): opendir() failure, error code = " << strerror(errno);
+			throw std::system_error(errno, std::generic_category(), ss.str());
+		}
 	}
 
-	std::vector<std::string> files;
+	posix_dir_reader(const posix_dir_reader&) = delete;
+	posix_dir_reader& operator=(const posix_dir_reader&) = delete;
 
-// For all systems except iOS < 13.0 we use new implementation via std::filesystem.
-// On iOS the std::filesystem is available only starting from iOS 13.0 while it
-// is still desired to support iOS 11.0 at least, so for iOS < 13.0 we fall back to old
-// implementation via 'dirent.h'.
-#if CFG_OS_NAME != CFG_OS_NAME_IOS || CFG_OS_IOS_DEPLOYMENT_TARGET >= 130000
-	std::filesystem::directory_iterator iter(this->path());
+	posix_dir_reader(posix_dir_reader&&) = delete;
+	posix_dir_reader& operator=(posix_dir_reader&&) = delete;
+
+	~posix_dir_reader() override
+	{
+		int ret = 0;
+		do {
+			ret = closedir(this->pdir);
+			ASSERT(ret == 0 || errno == EINTR, [](auto& o) {
+				o << "fs_file::list_dir(): closedir() failed: " << strerror(errno);
+			})
+		} while (ret != 0 && errno == EINTR);
+	}
+
+	const dir_entry* next() override
+	{
+		for (;;) {
+			errno = 0;
+			dirent* pent = readdir(this->pdir);
+			if (!pent) {
+				// check if readdir() failed
+				if (errno != 0) {
+					std::stringstream ss;
+					ss << "fs_file::list_dir(): readdir() failure, error code = " << strerror(errno);
+					throw std::system_error(errno, std::system_category(), ss.str());
+				}
+				return nullptr;
+			}
+
+			std::string_view entry_name(static_cast<const char*>(pent->d_name));
+			if (entry_name == "." || entry_name == "..") {
+				continue; // do not add ./ and ../ directories, we are not interested in them
+			}
+
+			bool is_dir = false;
+			bool is_symlink = false;
+			bool is_type_known = false;
+#	ifdef DT_UNKNOWN
+			if (pent->d_type != DT_UNKNOWN) {
+				is_symlink = pent->d_type == DT_LNK;
+				is_dir = pent->d_type == DT_DIR;
+				is_type_known = true;
+			}
+#	endif
+
+			// clang-format off
+			struct stat file_stats{};
+			// clang-format on
+
+			if (!is_type_known) {
+				// the file system does not report entry types
+				if (fstatat(
+						dirfd(this->pdir),
+						static_cast<const char*>(pent->d_name),
+						&file_stats,
+						AT_SYMLINK_NOFOLLOW
+					) < 0)
+				{
+					// the entry has been removed after reading it, list it as a file
+					if (errno != ENOENT) {
+						std::stringstream ss;
+						ss << "fs_file::list_dir(): fstatat() failure, error code = " << strerror(errno);
+						throw std::system_error(errno, std::system_category(), ss.str());
+					}
+				} else {
+					is_symlink = S_ISLNK(file_stats.st_mode);
+					is_dir = S_ISDIR(file_stats.st_mode);
+				}
+			}
+
+			if (is_symlink) {
+				// follow symbolic links, so that links to directories are listed as directories
+				if (fstatat(dirfd(this->pdir), static_cast<const char*>(pent->d_name), &file_stats, 0) < 0) {
+					// dangling symbolic link is listed as a file
+					if (errno != ENOENT) {
+						std::stringstream ss;
+						ss << "fs_file::list_dir(): fstatat() failure, error code = " << strerror(errno);
+						throw std::system_error(errno, std::system_category(), ss.str());
+					}
+				} else {
+					is_dir = S_ISDIR(file_stats.st_mode);
+				}
+			}
 
-	for (const auto& p : iter) {
-		std::string name = papki::not_dir(p.path().string());
+			this->name.assign(entry_name);
+			if (is_dir) {
+				this->name.push_back('/');
+			}
+
+			this->entry.name = this->name;
+			this->entry.is_dir = is_dir;
+			this->entry.is_symlink = is_symlink;
+			return &this->entry;
+		}
+	}
+
+	std::optional<file_id> dir_id() const override
+	{
+		// clang-format off
+		struct stat dir_stats{};
+		// clang-format on
+		if (fstat(dirfd(this->pdir), &dir_stats) < 0) {
+			throw std::system_error(errno, std::system_category(), "fs_file::dir_entries(): fstat() failed");
+		}
+		return file_id{uint64_t(dir_stats.st_dev), uint64_t(dir_stats.st_ino)};
+	}
+};
+#elif CFG_OS_NAME != CFG_OS_NAME_IOS || CFG_OS_IOS_DEPLOYMENT_TARGET >= 130000
+class filesystem_dir_reader : public dir_reader
+{
+	std::filesystem::directory_iterator iter;
+
+	std::string name;
+	dir_entry entry;
+
+	bool is_first = true;
+
+public:
+	filesystem_dir_reader(const std::string& path) :
+		iter(path)
+	{}
+
+	const dir_entry* next() override
+	{
+		if (this->is_first) {
+			this->is_first = false;
+		} else if (this->iter != std::filesystem::directory_iterator()) {
+			++this->iter;
+		}
 
-		if (p.is_directory()) {
-			name += "/";
+		if (this->iter == std::filesystem::directory_iterator()) {
+			return nullptr;
 		}
 
-		files.push_back(name);
+		const auto& p = *this->iter;
+
+		this->entry.is_dir = p.is_directory();
+		this->entry.is_symlink = p.is_symlink();
+
+		this->name = papki::not_dir(p.path().string());
+		if (this->entry.is_dir) {
+			this->name.push_back('/');
+		}
+		this->entry.name = this->name;
+
+		return &this->entry;
+	}
+};
+#endif
+} // namespace
+
+dir_entry_range fs_file::dir_entries() const
+{
+	if (!this->is_dir()) {
+		throw std::logic_error("fs_file::dir_entries(): this is not a directory");
+	}
+
+#if CFG_OS == CFG_OS_LINUX || CFG_OS == CFG_OS_MACOSX || CFG_OS == CFG_OS_UNIX
+	return dir_entry_range(std::make_unique<posix_dir_reader>(this->path()));
+#elif CFG_OS_NAME != CFG_OS_NAME_IOS || CFG_OS_IOS_DEPLOYMENT_TARGET >= 130000
+	return dir_entry_range(std::make_unique<filesystem_dir_reader>(this->path()));
+#else
+	return this->file::dir_entries();
+#endif
+}
+
+namespace {
+// Reads directory listing into either std::vector<std::string> or dir_listing.
+template <typename listing_type>
+listing_type read_dir_listing(const fs_file& f, size_t max_size)
+{
+	if (!f.is_dir()) {
+		throw std::logic_error("fs_file::list_dir(): this is not a directory");
+	}
+
+	listing_type files;
+
+#if CFG_OS == CFG_OS_LINUX || CFG_OS == CFG_OS_MACOSX || CFG_OS == CFG_OS_UNIX || \
+	CFG_OS_NAME != CFG_OS_NAME_IOS || CFG_OS_IOS_DEPLOYMENT_TARGET >= 130000
+	for (auto& e : f.dir_entries()) {
+		if constexpr (std::is_same_v<listing_type, dir_listing>) {
+			// the name is copied straight into the arena of the listing
+			files.push_back(e.name);
+		} else {
+			files.emplace_back(e.name);
+		}
 		if (files.size() == max_size) {
 			break;
 		}
 	}
-#else
-	// Old implementation, used before std::filesystem became available. The code
-	// is still kept here because std::filesystem support is not very common yet
-	// and on some systems it might be needed to revert back to this old
-	// implementation.
-#	if CFG_OS == CFG_OS_WINDOWS
+#elif CFG_OS == CFG_OS_WINDOWS
+	// Old implementation, used before std::filesystem became available.
 	{
-		std::string pattern = this->path();
+		std::string pattern = f.path();
 		pattern += '*';
 
 		LOG([&](auto& o) {
@@ -366,74 +1383,23 @@ std::vector<std::string> fs_file::list_dir(size_t max_size) const
 			}
 		}
 	}
-#	elif CFG_OS == CFG_OS_LINUX || CFG_OS == CFG_OS_MACOSX
-	{
-		DIR* pdir = opendir(this->path().c_str());
-
-		if (!pdir) {
-			std::stringstream ss;
-			ss << "fs_file::list_dir(): opendir() failure, error code = " << strerror(errno);
-			throw std::system_error(errno, std::generic_category(), ss.str());
-		}
-
-		// create DirentCloser to automatically call closedir on exit from the
-		// function in case of exceptions etc...
-		struct DirCloser {
-			DIR* pdir;
-
-			DirCloser(DIR* pDirToClose) :
-				pdir(pDirToClose)
-			{}
-
-			~DirCloser()
-			{
-				int ret;
-				do {
-					ret = closedir(this->pdir);
-					ASSERT(ret == 0 || errno == EINTR, [](auto& o) {
-						o << "fs_file::list_dir(): closedir() failed: " << strerror(errno);
-					})
-				} while (ret != 0 && errno == EINTR);
-			}
-		} dirCloser(pdir);
-
-		errno = 0;
-		while (dirent* pent = readdir(pdir)) {
-			std::string s(pent->d_name);
-			if (s == "." || s == "..")
-				continue; // do not add ./ and ../ directories, we are not interested in them
-
-			struct stat fileStats;
-			if (stat((this->path() + s).c_str(), &fileStats) < 0) {
-				std::stringstream ss;
-				ss << "fs_file::list_dir(): stat() failure, error code = " << strerror(errno);
-				throw std::system_error(errno, std::system_category(), ss.str());
-			}
-
-			if (fileStats.st_mode & S_IFDIR) // if this entry is a directory append '/' symbol to its end
-				s += "/";
-
-			files.push_back(s);
-
-			if (files.size() == max_size) {
-				break;
-			}
-		}
-
-		// check if we exited the while() loop because of readdir() failed
-		if (errno != 0) {
-			std::stringstream ss;
-			ss << "fs_file::list_dir(): readdir() failure, error code = " << strerror(errno);
-			throw std::system_error(errno, std::system_category(), ss.str());
-		}
-	}
-#	else
-#		error "fs_file::list_dir(): is not implemented yet for this os"
-#	endif
+#else
+#	error "fs_file::list_dir(): is not implemented yet for this os"
 #endif
 
 	return files;
 }
+} // namespace
+
+std::vector<std::string> fs_file::list_dir(size_t max_size) const
+{
+	return read_dir_listing<std::vector<std::string>>(*this, max_size);
+}
+
+dir_listing fs_file::list_dir_compact(size_t max_size) const
+{
+	return read_dir_listing<dir_listing>(*this, max_size);
+}
 
 uint64_t fs_file::size() const
 {
@@ -484,5 +1450,5 @@ uint64_t fs_file::size() const
 
 std::unique_ptr<file> fs_file::spawn()
 {
-	return std::make_unique<fs_file>();
+	return std::make_unique<fs_file>(std::string_view(), this->file_access);
 }
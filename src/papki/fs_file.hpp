@@ -29,6 +29,7 @@ SOFTWARE.
 
 #include <cstdio>
 #include <memory>
+#include <optional>
 
 #include <utki/config.hpp>
 #include <utki/debug.hpp>
@@ -47,8 +48,42 @@ namespace papki {
  */
 class fs_file : public file
 {
+public:
+	/**
+	 * @brief File access method.
+	 */
+	enum class access {
+		/**
+		 * @brief Access the file via C standard library streams.
+		 * The file is accessed with fopen()/fread()/fwrite() which do
+		 * user-space buffering of the data.
+		 */
+		stdio,
+
+		/**
+		 * @brief Access the file via raw file descriptor.
+		 * The file is accessed with open()/read()/write()/pread(), there is no user-space
+		 * buffering and no per-stream locking, the data is read directly to the caller's buffer.
+		 * This is good for reading large chunks of data. For small reads each read is a system call,
+		 * so consider wrapping the file into buffered_file in that case.
+		 * The file descriptor is opened with O_CLOEXEC flag.
+		 * On Windows this access method falls back to stdio.
+		 */
+		fd
+	};
+
+private:
+	const access file_access;
+
 	mutable FILE* handle = nullptr;
 
+	// file descriptor of the opened file in case of access::fd
+	mutable int fd = -1;
+
+	// Size of the opened file, it is used to prevent seeking beyond the end of file.
+	// Only regular files have size, for other files, e.g. pipes, it is std::nullopt.
+	mutable std::optional<uint64_t> file_size;
+
 protected:
 	void open_internal(papki::mode io_mode) override;
 
@@ -56,16 +91,32 @@ protected:
 
 	size_t read_internal(utki::span<uint8_t> buf) const override;
 
+	size_t read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const override;
+
+	// NOTE: on Linux the reads are done via io_uring, if it is available,
+	//       on other systems the reads are synchronous.
+	std::future<size_t> read_at_async_internal(uint64_t offset, utki::span<uint8_t> buf) const override;
+
 	size_t write_internal(utki::span<const uint8_t> buf) override;
 
-	// NOTE: use default implementation of seek_forward() because of the problems
-	// with
-	//       fseek(), as it can set file pointer beyond the end of file.
+	// NOTE: fseek() can set file pointer beyond the end of file, so the seek
+	//       distance is clamped to the file size.
+	size_t seek_forward_internal(size_t num_bytes_to_seek) const override;
 
 	size_t seek_backward_internal(size_t num_bytes_to_seek) const override;
 
 	void rewind_internal() const override;
 
+	uint64_t seek_internal(uint64_t position) const override;
+
+	std::optional<uint64_t> size_hint_internal() const override;
+
+	// NOTE: the hints are passed to the OS via posix_fadvise() and readahead() on Linux,
+	//       on other systems the hints are ignored.
+	void advise_internal(access_hint hint, uint64_t offset, uint64_t length) const override;
+
+	void prefetch_internal(uint64_t offset, uint64_t length) const override;
+
 public:
 	/**
 	 * @brief Constructor.
@@ -76,9 +127,11 @@ public:
 	 * final path which is a concatenation of the root directory and the path
 	 * returned by path() method.
 	 * @param path_name - initial path to set passed to file constructor.
+	 * @param file_access - file access method.
 	 */
-	fs_file(std::string_view path_name = std::string_view()) :
-		file(path_name)
+	fs_file(std::string_view path_name = std::string_view(), access file_access = access::stdio) :
+		file(path_name),
+		file_access(file_access)
 	{}
 
 	fs_file(const fs_file&) = delete;
@@ -112,6 +165,10 @@ public:
 
 	std::vector<std::string> list_dir(size_t max_entries = 0) const override;
 
+	dir_listing list_dir_compact(size_t max_entries = std::numeric_limits<size_t>::max()) const override;
+
+	dir_entry_range dir_entries() const override;
+
 	std::unique_ptr<file> spawn() override;
 };
 
@@ -0,0 +1,211 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "inflate_engine.hpp"
+
+#include <array>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <zlib.h>
+
+using namespace papki;
+
+namespace {
+struct inflate_stream {
+	z_stream strm{};
+
+	inflate_stream()
+	{
+		// negative window bits value means raw deflate data, without zlib header
+		if (inflateInit2(&this->strm, -MAX_WBITS) != Z_OK) {
+			throw std::runtime_error("zlib_inflate_engine: inflateInit2() failed");
+		}
+	}
+
+	inflate_stream(const inflate_stream&) = delete;
+	inflate_stream& operator=(const inflate_stream&) = delete;
+
+	inflate_stream(inflate_stream&&) = delete;
+	inflate_stream& operator=(inflate_stream&&) = delete;
+
+	~inflate_stream()
+	{
+		inflateEnd(&this->strm);
+	}
+};
+
+// zlib counts the data with 32 bit values, so bigger buffers are passed to it in chunks
+constexpr auto max_chunk_size = size_t(std::numeric_limits<uInt>::max());
+
+z_stream& get_reset_stream()
+{
+	// the stream is created on first use within a thread and is reset for every subsequent use
+	thread_local inflate_stream stream;
+
+	if (inflateReset(&stream.strm) != Z_OK) {
+		throw std::runtime_error("zlib_inflate_engine: inflateReset() failed");
+	}
+
+	return stream.strm;
+}
+
+[[noreturn]] void throw_inflating_failed(const z_stream& strm)
+{
+	std::stringstream ss;
+	ss << "zlib_inflate_engine: inflating failed: ";
+	if (strm.msg) {
+		ss << strm.msg;
+	} else if (strm.avail_out == 0) {
+		ss << "uncompressed data is bigger than expected";
+	} else {
+		ss << "compressed data is truncated";
+	}
+	throw std::runtime_error(ss.str());
+}
+} // namespace
+
+void inflate_engine::inflate_streamed(
+	const std::function<utki::span<const uint8_t>()>& next_input,
+	utki::span<uint8_t> uncompressed
+) const
+{
+	std::vector<uint8_t> compressed;
+	for (auto piece = next_input(); !piece.empty(); piece = next_input()) {
+		compressed.insert(compressed.end(), piece.begin(), piece.end());
+	}
+	this->inflate(utki::make_span(compressed), uncompressed);
+}
+
+void zlib_inflate_engine::inflate(utki::span<const uint8_t> compressed, utki::span<uint8_t> uncompressed) const
+{
+	auto& strm = get_reset_stream();
+
+	// zlib refuses null output buffer even if there is no output
+	std::array<uint8_t, 1> empty_output{};
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast), zlib does not modify the input
+	strm.next_in = const_cast<uint8_t*>(compressed.data());
+	strm.avail_in = 0;
+	strm.next_out = uncompressed.empty() ? empty_output.data() : uncompressed.data();
+	strm.avail_out = 0;
+
+	size_t num_in_bytes_left = compressed.size();
+	size_t num_out_bytes_left = uncompressed.size();
+
+	for (;;) {
+		if (strm.avail_in == 0) {
+			auto num_bytes = std::min(num_in_bytes_left, max_chunk_size);
+			strm.avail_in = uInt(num_bytes);
+			num_in_bytes_left -= num_bytes;
+		}
+		if (strm.avail_out == 0) {
+			auto num_bytes = std::min(num_out_bytes_left, max_chunk_size);
+			strm.avail_out = uInt(num_bytes);
+			num_out_bytes_left -= num_bytes;
+		}
+
+		// with Z_FINISH zlib does not maintain its sliding window if the stream completes in one call
+		bool is_last_chunk = num_in_bytes_left == 0 && num_out_bytes_left == 0;
+		int ret = ::inflate(&strm, is_last_chunk ? Z_FINISH : Z_NO_FLUSH);
+
+		if (ret == Z_STREAM_END) {
+			break;
+		}
+		if (ret == Z_OK && !is_last_chunk) {
+			continue;
+		}
+
+		throw_inflating_failed(strm);
+	}
+
+	if (strm.avail_out != 0 || num_out_bytes_left != 0) {
+		throw std::runtime_error("zlib_inflate_engine: inflating failed: uncompressed data is smaller than expected");
+	}
+}
+
+void zlib_inflate_engine::inflate_streamed(
+	const std::function<utki::span<const uint8_t>()>& next_input,
+	utki::span<uint8_t> uncompressed
+) const
+{
+	auto& strm = get_reset_stream();
+
+	// zlib refuses null output buffer even if there is no output
+	std::array<uint8_t, 1> empty_output{};
+
+	strm.avail_in = 0;
+	strm.next_out = uncompressed.empty() ? empty_output.data() : uncompressed.data();
+	strm.avail_out = 0;
+
+	utki::span<const uint8_t> input;
+	size_t num_out_bytes_left = uncompressed.size();
+
+	for (;;) {
+		if (strm.avail_in == 0) {
+			if (input.empty()) {
+				input = next_input();
+				if (input.empty()) {
+					throw_inflating_failed(strm);
+				}
+			}
+			auto num_bytes = std::min(input.size(), max_chunk_size);
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast), zlib does not modify the input
+			strm.next_in = const_cast<uint8_t*>(input.data());
+			strm.avail_in = uInt(num_bytes);
+			input = input.subspan(num_bytes);
+		}
+		if (strm.avail_out == 0) {
+			auto num_bytes = std::min(num_out_bytes_left, max_chunk_size);
+			strm.avail_out = uInt(num_bytes);
+			num_out_bytes_left -= num_bytes;
+		}
+
+		int ret = ::inflate(&strm, Z_NO_FLUSH);
+
+		if (ret == Z_STREAM_END) {
+			break;
+		}
+		if (ret == Z_OK) {
+			continue;
+		}
+
+		throw_inflating_failed(strm);
+	}
+
+	if (strm.avail_out != 0 || num_out_bytes_left != 0) {
+		throw std::runtime_error("zlib_inflate_engine: inflating failed: uncompressed data is smaller than expected");
+	}
+}
+
+const std::shared_ptr<const zlib_inflate_engine>& zlib_inflate_engine::get()
+{
+	static const auto instance = std::make_shared<const zlib_inflate_engine>();
+	return instance;
+}
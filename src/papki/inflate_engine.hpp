@@ -0,0 +1,107 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <utki/span.hpp>
+
+namespace papki {
+
+/**
+ * @brief Decoder of deflate compressed data.
+ * The engine decompresses whole deflate stream into a buffer of known size at once.
+ * The compressed data is either held in memory as a whole, or is supplied in pieces.
+ * It is used by zip_file to load whole deflated zip entries, see zip_file::set_inflate_engine().
+ * The default engine is zlib_inflate_engine. Other deflate decoders can be plugged in
+ * by implementing this interface.
+ * Implementations must allow concurrent calls to inflate() from different threads.
+ */
+class inflate_engine
+{
+public:
+	inflate_engine() = default;
+
+	inflate_engine(const inflate_engine&) = delete;
+	inflate_engine& operator=(const inflate_engine&) = delete;
+
+	inflate_engine(inflate_engine&&) = delete;
+	inflate_engine& operator=(inflate_engine&&) = delete;
+
+	virtual ~inflate_engine() = default;
+
+	/**
+	 * @brief Decompress raw deflate data.
+	 * The data has no zlib or gzip header and trailer, as it is stored in zip archives.
+	 * @param compressed - whole deflate stream.
+	 * @param uncompressed - buffer to decompress the data to, of the exact uncompressed size.
+	 * @throw std::runtime_error - if the compressed data is corrupted, or its uncompressed size
+	 *                             does not match the size of the buffer.
+	 */
+	virtual void inflate(utki::span<const uint8_t> compressed, utki::span<uint8_t> uncompressed) const = 0;
+
+	/**
+	 * @brief Decompress raw deflate data supplied in pieces.
+	 * This is used when the compressed data does not reside in memory, e.g. is read from a file.
+	 * Default implementation collects all the pieces into a buffer and passes it to inflate().
+	 * @param next_input - function returning next piece of the deflate stream. The piece stays valid
+	 *                     until the next call of the function. Empty piece means there is no more data.
+	 * @param uncompressed - buffer to decompress the data to, of the exact uncompressed size.
+	 * @throw std::runtime_error - if the compressed data is corrupted, or its uncompressed size
+	 *                             does not match the size of the buffer.
+	 */
+	virtual void inflate_streamed(
+		const std::function<utki::span<const uint8_t>()>& next_input,
+		utki::span<uint8_t> uncompressed
+	) const;
+};
+
+/**
+ * @brief Inflate engine based on zlib.
+ * The zlib inflate streams are reused across calls, one stream per thread.
+ */
+class zlib_inflate_engine : public inflate_engine
+{
+public:
+	void inflate(utki::span<const uint8_t> compressed, utki::span<uint8_t> uncompressed) const override;
+
+	void inflate_streamed(
+		const std::function<utki::span<const uint8_t>()>& next_input,
+		utki::span<uint8_t> uncompressed
+	) const override;
+
+	/**
+	 * @brief Get shared instance of the engine.
+	 * The engine has no state of its own, so the same instance can be used everywhere.
+	 * @return zlib inflate engine.
+	 */
+	static const std::shared_ptr<const zlib_inflate_engine>& get();
+};
+
+} // namespace papki
@@ -0,0 +1,315 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "mmap_file.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include <utki/config.hpp>
+#include <utki/util.hpp>
+
+#if CFG_OS == CFG_OS_WINDOWS
+#	include <utki/windows.hpp>
+#elif CFG_OS == CFG_OS_LINUX || CFG_OS == CFG_OS_MACOSX || CFG_OS == CFG_OS_UNIX
+#	include <cerrno>
+
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+using namespace papki;
+
+void mmap_file::open_internal(papki::mode io_mode)
+{
+	if (io_mode != papki::mode::read) {
+		throw std::invalid_argument("mmap_file::open(): only read mode is supported");
+	}
+
+	ASSERT(!this->mapping)
+	ASSERT(this->mapping_size == 0)
+
+	this->idx = 0;
+
+#if CFG_OS == CFG_OS_WINDOWS
+	HANDLE hfile = CreateFileA(
+		this->path().c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr
+	);
+	if (hfile == INVALID_HANDLE_VALUE) {
+		std::stringstream ss;
+		ss << "CreateFile(" << this->path() << ") failed";
+		throw std::system_error(int(GetLastError()), std::generic_category(), ss.str());
+	}
+	utki::scope_exit hfile_scope_exit([&hfile]() {
+		CloseHandle(hfile);
+	});
+
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(hfile, &size) == 0) {
+		throw std::system_error(int(GetLastError()), std::generic_category(), "GetFileSizeEx() failed");
+	}
+
+	if (size.QuadPart == 0) {
+		// empty files cannot be mapped
+		return;
+	}
+
+	HANDLE hmapping = CreateFileMappingA(hfile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!hmapping) {
+		throw std::system_error(int(GetLastError()), std::generic_category(), "CreateFileMapping() failed");
+	}
+	utki::scope_exit hmapping_scope_exit([&hmapping]() {
+		// the mapped view holds a reference to the mapping object, so it is ok to close the handle
+		CloseHandle(hmapping);
+	});
+
+	void* ptr = MapViewOfFile(hmapping, FILE_MAP_READ, 0, 0, 0);
+	if (!ptr) {
+		throw std::system_error(int(GetLastError()), std::generic_category(), "MapViewOfFile() failed");
+	}
+
+	this->mapping = static_cast<const uint8_t*>(ptr);
+	this->mapping_size = size_t(size.QuadPart);
+#elif CFG_OS == CFG_OS_LINUX || CFG_OS == CFG_OS_MACOSX || CFG_OS == CFG_OS_UNIX
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+	int fd = ::open(this->path().c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		std::stringstream ss;
+		ss << "open(" << this->path() << ") failed";
+		throw std::system_error(errno, std::generic_category(), ss.str());
+	}
+	utki::scope_exit fd_scope_exit([&fd]() {
+		// the mapping stays valid after closing the file descriptor
+		::close(fd);
+	});
+
+	// clang-format off
+
+	struct stat file_stats{};
+
+	// clang-format on
+
+	if (fstat(fd, &file_stats) < 0) {
+		throw std::system_error(errno, std::generic_category(), "fstat() failed");
+	}
+
+	if (!S_ISREG(file_stats.st_mode)) {
+		std::stringstream ss;
+		ss << "mmap_file::open(): " << this->path() << " is not a regular file";
+		throw std::runtime_error(ss.str());
+	}
+
+	if (file_stats.st_size == 0) {
+		// Pseudo files, like the ones in /proc, report zero size but do have contents,
+		// these cannot be mapped.
+		uint8_t byte = 0;
+		if (pread(fd, &byte, 1, 0) > 0) {
+			std::stringstream ss;
+			ss << "mmap_file::open(): size of " << this->path() << " is unknown, it cannot be mapped";
+			throw std::runtime_error(ss.str());
+		}
+
+		// empty files cannot be mapped
+		return;
+	}
+
+	if (uint64_t(file_stats.st_size) > std::numeric_limits<size_t>::max()) {
+		throw std::runtime_error("mmap_file::open(): file is too big to be mapped");
+	}
+
+	void* ptr = mmap(nullptr, size_t(file_stats.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-cstyle-cast, performance-no-int-to-ptr)
+	if (ptr == MAP_FAILED) {
+		throw std::system_error(errno, std::generic_category(), "mmap() failed");
+	}
+
+	this->mapping = static_cast<const uint8_t*>(ptr);
+	this->mapping_size = size_t(file_stats.st_size);
+#else
+	throw std::runtime_error("mmap_file::open(): memory mapped files are not supported on this OS");
+#endif
+}
+
+void mmap_file::close_internal() const noexcept
+{
+	if (this->mapping) {
+#if CFG_OS == CFG_OS_WINDOWS
+		if (UnmapViewOfFile(this->mapping) == 0) {
+			ASSERT(false, [](auto& o) {
+				o << "mmap_file::close(): UnmapViewOfFile() failed";
+			})
+		}
+#elif CFG_OS == CFG_OS_LINUX || CFG_OS == CFG_OS_MACOSX || CFG_OS == CFG_OS_UNIX
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+		if (munmap(const_cast<uint8_t*>(this->mapping), this->mapping_size) != 0) {
+			ASSERT(false, [](auto& o) {
+				o << "mmap_file::close(): munmap() failed: " << strerror(errno);
+			})
+		}
+#endif
+	}
+
+	this->mapping = nullptr;
+	this->mapping_size = 0;
+	this->idx = 0;
+}
+
+size_t mmap_file::read_internal(utki::span<uint8_t> buf) const
+{
+	ASSERT(this->idx <= this->mapping_size)
+	size_t num_bytes_read = std::min(buf.size(), this->mapping_size - this->idx);
+	if (num_bytes_read != 0) {
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		std::memcpy(buf.data(), this->mapping + this->idx, num_bytes_read);
+	}
+	this->idx += num_bytes_read;
+	ASSERT(this->idx <= this->mapping_size)
+	return num_bytes_read;
+}
+
+size_t mmap_file::read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const
+{
+	if (offset >= this->mapping_size) {
+		return 0;
+	}
+	size_t num_bytes_read = std::min(buf.size(), size_t(this->mapping_size - offset));
+	if (num_bytes_read != 0) {
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		std::memcpy(buf.data(), this->mapping + offset, num_bytes_read);
+	}
+	return num_bytes_read;
+}
+
+void mmap_file::advise_internal(access_hint hint, uint64_t offset, uint64_t length) const
+{
+#if CFG_OS == CFG_OS_LINUX || CFG_OS == CFG_OS_MACOSX || CFG_OS == CFG_OS_UNIX
+	if (offset >= this->mapping_size) {
+		return;
+	}
+
+	if (length == 0 || length > this->mapping_size - offset) {
+		length = this->mapping_size - offset;
+	}
+
+	int advice = [&hint]() {
+		switch (hint) {
+			case access_hint::sequential:
+				return POSIX_MADV_SEQUENTIAL;
+			case access_hint::random:
+				return POSIX_MADV_RANDOM;
+			case access_hint::will_need:
+				return POSIX_MADV_WILLNEED;
+			case access_hint::dont_need:
+				return POSIX_MADV_DONTNEED;
+			default:
+				return POSIX_MADV_NORMAL;
+		}
+	}();
+
+	// the address passed to posix_madvise() has to be page aligned
+	auto page_size = uint64_t(sysconf(_SC_PAGESIZE));
+	uint64_t begin = offset - offset % page_size;
+
+	// the hint is advisory, so errors are ignored
+	posix_madvise(
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast, cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		const_cast<uint8_t*>(this->mapping + begin),
+		size_t(offset + length - begin),
+		advice
+	);
+#endif
+}
+
+void mmap_file::prefetch_internal(uint64_t offset, uint64_t length) const
+{
+	this->advise_internal(access_hint::will_need, offset, length);
+}
+
+size_t mmap_file::write_internal(utki::span<const uint8_t> /* buf */)
+{
+	throw std::logic_error("mmap_file::write(): memory mapped file is read only");
+}
+
+size_t mmap_file::seek_forward_internal(size_t num_bytes_to_seek) const
+{
+	ASSERT(this->idx <= this->mapping_size)
+	num_bytes_to_seek = std::min(this->mapping_size - this->idx, num_bytes_to_seek);
+	this->idx += num_bytes_to_seek;
+	ASSERT(this->idx <= this->mapping_size)
+	return num_bytes_to_seek;
+}
+
+size_t mmap_file::seek_backward_internal(size_t num_bytes_to_seek) const
+{
+	ASSERT(this->idx <= this->mapping_size)
+	num_bytes_to_seek = std::min(this->idx, num_bytes_to_seek);
+	this->idx -= num_bytes_to_seek;
+	ASSERT(this->idx <= this->mapping_size)
+	return num_bytes_to_seek;
+}
+
+void mmap_file::rewind_internal() const
+{
+	this->idx = 0;
+}
+
+uint64_t mmap_file::seek_internal(uint64_t position) const
+{
+	this->idx = size_t(std::min(uint64_t(this->mapping_size), position));
+	return this->idx;
+}
+
+utki::span<const uint8_t> mmap_file::data() const
+{
+	if (!this->is_open()) {
+		throw std::logic_error("mmap_file::data(): file is not opened");
+	}
+	return utki::make_span(this->mapping, this->mapping_size);
+}
+
+uint64_t mmap_file::size() const
+{
+	if (this->is_open()) {
+		return this->mapping_size;
+	}
+	return this->fs_file::size();
+}
+
+std::unique_ptr<file> mmap_file::spawn()
+{
+	return std::make_unique<mmap_file>();
+}
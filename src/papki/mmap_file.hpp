@@ -0,0 +1,137 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+
+#include "fs_file.hpp"
+
+#ifdef assert
+#	undef assert
+#endif
+
+namespace papki {
+
+/**
+ * @brief Memory mapped native file system file.
+ * Read-only implementation of a papki::file interface which maps the whole file
+ * into the address space of the process on opening. Reading and seeking is done
+ * directly over the mapped memory, without calls to the OS.
+ * Only regular files of known size can be mapped, opening other files, e.g. devices or
+ * pseudo files of /proc, throws std::runtime_error.
+ * All other operations, like listing directories, checking for file existence etc.,
+ * are same as of papki::fs_file.
+ */
+class mmap_file : public fs_file
+{
+	mutable const uint8_t* mapping = nullptr;
+	mutable size_t mapping_size = 0;
+
+	mutable size_t idx = 0; // current file position
+
+protected:
+	void open_internal(papki::mode io_mode) override;
+
+	void close_internal() const noexcept override;
+
+	size_t read_internal(utki::span<uint8_t> buf) const override;
+
+	size_t read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const override;
+
+	std::future<size_t> read_at_async_internal(uint64_t offset, utki::span<uint8_t> buf) const override
+	{
+		// the data is in memory, no need to read it asynchronously
+		return this->file::read_at_async_internal(offset, buf);
+	}
+
+	size_t write_internal(utki::span<const uint8_t> buf) override;
+
+	size_t seek_forward_internal(size_t num_bytes_to_seek) const override;
+
+	size_t seek_backward_internal(size_t num_bytes_to_seek) const override;
+
+	void rewind_internal() const override;
+
+	uint64_t seek_internal(uint64_t position) const override;
+
+	std::optional<uint64_t> size_hint_internal() const override
+	{
+		return this->mapping_size;
+	}
+
+	std::optional<utki::span<const uint8_t>> memory_view_internal() const override
+	{
+		return utki::make_span(this->mapping, this->mapping_size);
+	}
+
+	// NOTE: the hints are passed to the OS via posix_madvise(), on Windows the hints are ignored.
+	void advise_internal(access_hint hint, uint64_t offset, uint64_t length) const override;
+
+	void prefetch_internal(uint64_t offset, uint64_t length) const override;
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param path_name - initial path to set passed to file constructor.
+	 */
+	mmap_file(std::string_view path_name = std::string_view()) :
+		fs_file(path_name)
+	{}
+
+	mmap_file(const mmap_file&) = delete;
+	mmap_file& operator=(const mmap_file&) = delete;
+
+	mmap_file(mmap_file&&) = delete;
+	mmap_file& operator=(mmap_file&&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * This destructor calls the close() method.
+	 */
+	~mmap_file() noexcept override
+	{
+		this->close();
+	}
+
+	/**
+	 * @brief Get contents of the opened file.
+	 * Returns the whole mapped file contents without copying.
+	 * Same as memory_view(), but the contents are always available.
+	 * The returned memory is valid until the file is closed.
+	 * @return Span of the mapped file contents.
+	 * @throw std::logic_error - if file is not opened.
+	 */
+	utki::span<const uint8_t> data() const;
+
+	uint64_t size() const override;
+
+	std::unique_ptr<file> spawn() override;
+};
+
+} // namespace papki
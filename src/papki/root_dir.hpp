@@ -98,11 +98,31 @@ private:
 		return this->base_file->list_dir(max_entries);
 	}
 
+	dir_listing list_dir_compact(size_t max_entries = std::numeric_limits<size_t>::max()) const override
+	{
+		return this->base_file->list_dir_compact(max_entries);
+	}
+
+	dir_entry_range dir_entries() const override
+	{
+		return this->base_file->dir_entries();
+	}
+
 	size_t read_internal(utki::span<uint8_t> buf) const override
 	{
 		return this->base_file->read(buf);
 	}
 
+	size_t read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const override
+	{
+		return this->base_file->read_at(offset, buf);
+	}
+
+	std::future<size_t> read_at_async_internal(uint64_t offset, utki::span<uint8_t> buf) const override
+	{
+		return this->base_file->read_at_async(offset, buf);
+	}
+
 	size_t write_internal(utki::span<const uint8_t> buf) override
 	{
 		return this->base_file->write(buf);
@@ -123,6 +143,38 @@ private:
 		this->base_file->rewind();
 	}
 
+	uint64_t seek_internal(uint64_t position) const override
+	{
+		return this->base_file->seek(position);
+	}
+
+	std::optional<uint64_t> size_hint_internal() const override
+	{
+		return this->base_file->size_hint();
+	}
+
+	std::vector<uint8_t> load_internal(size_t max_bytes_to_load) const override
+	{
+		// load() of the base file opens it by itself
+		this->base_file->close();
+		return this->base_file->load(max_bytes_to_load);
+	}
+
+	std::optional<utki::span<const uint8_t>> memory_view_internal() const override
+	{
+		return this->base_file->memory_view();
+	}
+
+	void advise_internal(access_hint hint, uint64_t offset, uint64_t length) const override
+	{
+		this->base_file->advise(hint, offset, length);
+	}
+
+	void prefetch_internal(uint64_t offset, uint64_t length) const override
+	{
+		this->base_file->prefetch(offset, length);
+	}
+
 	void make_dir() override
 	{
 		this->base_file->make_dir();
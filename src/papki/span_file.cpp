@@ -53,6 +53,17 @@ size_t span_file::read_internal(utki::span<uint8_t> buf) const
 	return num_bytes_read;
 }
 
+size_t span_file::read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const
+{
+	if (offset >= this->data.size()) {
+		return 0;
+	}
+	size_t num_bytes_read = std::min(buf.size(), size_t(this->data.size() - offset));
+	auto begin = utki::next(this->data.begin(), offset);
+	std::copy(begin, utki::next(begin, num_bytes_read), buf.begin());
+	return num_bytes_read;
+}
+
 size_t span_file::write_internal(utki::span<const uint8_t> buf)
 {
 	ASSERT(this->iter <= this->data.end())
@@ -86,6 +97,13 @@ void span_file::rewind_internal() const
 	this->iter = this->data.begin();
 }
 
+uint64_t span_file::seek_internal(uint64_t position) const
+{
+	auto pos = size_t(std::min(uint64_t(this->data.size()), position));
+	this->iter = utki::next(this->data.begin(), pos);
+	return pos;
+}
+
 std::unique_ptr<file> span_file::spawn()
 {
 	return std::make_unique<span_file>(this->data);
@@ -27,11 +27,14 @@ SOFTWARE.
 
 #include "util.hpp"
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
 #include <string_view>
 
 #include <utki/debug.hpp>
 #include <utki/string.hpp>
+#include <zlib.h>
 
 using namespace std::string_literals;
 
@@ -133,3 +136,14 @@ std::string_view papki::as_file(std::string_view path)
 	}
 	return path;
 }
+
+uint32_t papki::update_crc32(uint32_t crc, utki::span<const uint8_t> data)
+{
+	// zlib counts the data with 32 bit values, so big buffers are processed in chunks
+	while (!data.empty()) {
+		auto num_bytes = std::min(data.size(), size_t(std::numeric_limits<uInt>::max()));
+		crc = uint32_t(crc32(crc, data.data(), uInt(num_bytes)));
+		data = data.subspan(num_bytes);
+	}
+	return crc;
+}
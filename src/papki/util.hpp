@@ -27,8 +27,11 @@ SOFTWARE.
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 
+#include <utki/span.hpp>
+
 namespace papki {
 
 /**
@@ -108,4 +111,13 @@ std::string as_dir(std::string_view path);
  */
 std::string_view as_file(std::string_view path);
 
+/**
+ * @brief Update CRC-32 checksum with more data.
+ * The checksum is the one used by zip and gzip formats.
+ * @param crc - checksum of the preceding data, 0 if there is no preceding data.
+ * @param data - data to update the checksum with.
+ * @return Checksum of the preceding data followed by the given data.
+ */
+uint32_t update_crc32(uint32_t crc, utki::span<const uint8_t> data);
+
 } // namespace papki
@@ -52,6 +52,17 @@ size_t vector_file::read_internal(utki::span<uint8_t> buf) const
 	return num_bytes_read;
 }
 
+size_t vector_file::read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const
+{
+	if (offset >= this->data.size()) {
+		return 0;
+	}
+	size_t num_bytes_read = std::min(buf.size_bytes(), size_t(this->data.size() - offset));
+	auto i = utki::next(this->data.begin(), offset);
+	std::copy(i, utki::next(i, num_bytes_read), buf.begin());
+	return num_bytes_read;
+}
+
 size_t vector_file::write_internal(utki::span<const uint8_t> buf)
 {
 	ASSERT(this->idx <= this->data.size())
@@ -93,3 +104,9 @@ void vector_file::rewind_internal() const
 {
 	this->idx = 0;
 }
+
+uint64_t vector_file::seek_internal(uint64_t position) const
+{
+	this->idx = size_t(std::min(uint64_t(this->data.size()), position));
+	return this->idx;
+}
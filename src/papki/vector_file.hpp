@@ -98,6 +98,8 @@ protected:
 
 	size_t read_internal(utki::span<uint8_t> buf) const override;
 
+	size_t read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const override;
+
 	size_t write_internal(utki::span<const uint8_t> buf) override;
 
 	size_t seek_forward_internal(size_t num_bytes_to_seek) const override;
@@ -105,6 +107,18 @@ protected:
 	size_t seek_backward_internal(size_t num_bytes_to_seek) const override;
 
 	void rewind_internal() const override;
+
+	uint64_t seek_internal(uint64_t position) const override;
+
+	std::optional<uint64_t> size_hint_internal() const override
+	{
+		return this->data.size();
+	}
+
+	std::optional<utki::span<const uint8_t>> memory_view_internal() const override
+	{
+		return utki::make_span(this->data);
+	}
 };
 
 } // namespace papki
@@ -0,0 +1,284 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "walk.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <utki/debug.hpp>
+
+using namespace papki;
+
+namespace {
+struct dir_task {
+	std::string path;
+	unsigned depth;
+
+	// whether the directory is reached via symbolic link
+	bool is_symlink;
+};
+
+// Double ended queue of directories to walk. The owning worker pushes and pops
+// directories at the back, so it walks the tree depth first, which keeps the number
+// of queued directories small. Other workers steal directories from the front,
+// those are the ones closest to the root and thus likely have largest subtrees.
+class task_queue
+{
+	std::mutex mutex;
+	std::deque<dir_task> tasks;
+
+public:
+	void push(dir_task task)
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->tasks.push_back(std::move(task));
+	}
+
+	std::optional<dir_task> pop()
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (this->tasks.empty()) {
+			return {};
+		}
+		auto ret = std::move(this->tasks.back());
+		this->tasks.pop_back();
+		return ret;
+	}
+
+	std::optional<dir_task> steal()
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (this->tasks.empty()) {
+			return {};
+		}
+		auto ret = std::move(this->tasks.front());
+		this->tasks.pop_front();
+		return ret;
+	}
+};
+} // namespace
+
+void papki::walk(
+	const file& root,
+	const std::function<void(const walk_entry& entry)>& on_entry,
+	const walk_parameters& params
+)
+{
+	if (!root.is_dir()) {
+		throw std::logic_error("papki::walk(): root is not a directory");
+	}
+
+	unsigned num_threads = params.num_threads;
+	if (num_threads == 0) {
+		num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	// spawn file objects for all workers beforehand, since spawning from the same object
+	// concurrently is not required to be thread-safe
+	std::vector<std::unique_ptr<file>> files;
+	files.reserve(num_threads);
+	for (unsigned i = 0; i != num_threads; ++i) {
+		// spawning does not modify the root file object, so it is ok to cast away the constness
+		files.push_back(const_cast<file&>(root).spawn());
+	}
+
+	std::vector<task_queue> queues(num_threads);
+
+	// number of directories which are queued or being walked
+	std::atomic<size_t> num_pending{1};
+
+	// number of directories which are queued or are being pushed to a queue
+	std::atomic<size_t> num_queued{1};
+
+	std::atomic<bool> stop{false};
+
+	std::mutex idle_mutex;
+	std::condition_variable idle_cv;
+
+	std::mutex error_mutex;
+	std::exception_ptr error;
+
+	// identities of walked directories, only used when following symbolic links
+	std::mutex visited_mutex;
+	std::set<file_id> visited;
+
+	// returns whether the directory is to be walked
+	auto visit = [&](const dir_entry_range& entries, const dir_task& task) {
+		if (!params.follow_symlinks) {
+			return true;
+		}
+
+		auto id = entries.dir_id();
+		if (!id) {
+			// without directory identity the loops cannot be detected, so the links are not followed
+			return !task.is_symlink;
+		}
+
+		std::lock_guard<std::mutex> lock(visited_mutex);
+		return visited.insert(id.value()).second;
+	};
+
+	queues.front().push(dir_task{root.path(), 0, false});
+
+	auto take_task = [&](unsigned worker_index) -> std::optional<dir_task> {
+		auto task = queues[worker_index].pop();
+		for (unsigned i = 1; !task && i != num_threads; ++i) {
+			task = queues[(worker_index + i) % num_threads].steal();
+		}
+		if (task) {
+			--num_queued;
+		}
+		return task;
+	};
+
+	auto worker = [&](unsigned worker_index) {
+		try {
+			auto& f = *files[worker_index];
+			auto& queue = queues[worker_index];
+
+			for (;;) {
+				auto task = take_task(worker_index);
+				if (!task) {
+					std::unique_lock<std::mutex> lock(idle_mutex);
+					idle_cv.wait(lock, [&]() {
+						return stop || num_pending == 0 || num_queued != 0;
+					});
+					if (stop || num_pending == 0) {
+						break;
+					}
+					continue;
+				}
+
+				f.set_path(task->path);
+
+				auto entries = f.dir_entries();
+				if (!visit(entries, task.value())) {
+					entries = dir_entry_range(nullptr);
+				}
+
+				for (const auto& e : entries) {
+					if (stop) {
+						break;
+					}
+
+					walk_entry entry;
+					entry.path.reserve(task->path.size() + e.name.size());
+					entry.path.append(task->path).append(e.name);
+					entry.is_dir = e.is_dir;
+					entry.size = e.size;
+					entry.is_symlink = e.is_symlink;
+					entry.depth = task->depth;
+
+					on_entry(entry);
+
+					if (!entry.is_dir || entry.depth == params.max_depth) {
+						continue;
+					}
+
+					if (entry.is_symlink && !params.follow_symlinks) {
+						continue;
+					}
+
+					if (params.prune && params.prune(entry)) {
+						continue;
+					}
+
+					// count the task before pushing it, so that a thief never decrements the counter below zero
+					++num_pending;
+					++num_queued;
+					queue.push(dir_task{std::move(entry.path), task->depth + 1, entry.is_symlink});
+					{
+						// lock the mutex to make sure idle worker is either not yet checking
+						// the wait condition or is already waiting, so the notification is not lost
+						std::lock_guard<std::mutex> lock(idle_mutex);
+					}
+					idle_cv.notify_one();
+				}
+
+				if (--num_pending == 0) {
+					{
+						std::lock_guard<std::mutex> lock(idle_mutex);
+					}
+					idle_cv.notify_all();
+				}
+			}
+		} catch (...) {
+			{
+				std::lock_guard<std::mutex> lock(error_mutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+
+			// make other workers to stop
+			{
+				std::lock_guard<std::mutex> lock(idle_mutex);
+				stop = true;
+			}
+			idle_cv.notify_all();
+		}
+	};
+
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(num_threads - 1);
+
+		try {
+			for (unsigned t = 1; t < num_threads; ++t) {
+				threads.emplace_back(worker, t);
+			}
+		} catch (...) {
+			{
+				std::lock_guard<std::mutex> lock(idle_mutex);
+				stop = true;
+			}
+			idle_cv.notify_all();
+			for (auto& t : threads) {
+				t.join();
+			}
+			throw;
+		}
+
+		// the calling thread is one of the workers
+		worker(0);
+
+		for (auto& t : threads) {
+			t.join();
+		}
+	}
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
@@ -0,0 +1,134 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <functional>
+#include <limits>
+#include <optional>
+#include <string>
+
+#include "file.hpp"
+
+namespace papki {
+
+/**
+ * @brief Entry found by walk().
+ */
+struct walk_entry {
+	/**
+	 * @brief Path of the entry.
+	 * The path starts with the path of the walk root, so it can be directly
+	 * set to a file object spawned from the root.
+	 * Paths of directories have trailing '/' character.
+	 */
+	std::string path;
+
+	/**
+	 * @brief Whether the entry is a directory.
+	 */
+	bool is_dir = false;
+
+	/**
+	 * @brief Size of the file, if known from the directory listing.
+	 */
+	std::optional<uint64_t> size;
+
+	/**
+	 * @brief Whether the entry is a symbolic link.
+	 * For symbolic links is_dir tells whether the link target is a directory.
+	 */
+	bool is_symlink = false;
+
+	/**
+	 * @brief Depth of the entry.
+	 * Direct children of the walk root have depth 0.
+	 */
+	unsigned depth = 0;
+};
+
+/**
+ * @brief Parameters of walk().
+ */
+struct walk_parameters {
+	/**
+	 * @brief Number of worker threads.
+	 * 0 means number of hardware threads.
+	 */
+	unsigned num_threads = 0;
+
+	/**
+	 * @brief Maximum depth to descend to.
+	 * Entries with depth greater than this are not reported.
+	 * 0 means only direct children of the walk root are reported.
+	 */
+	unsigned max_depth = std::numeric_limits<unsigned>::max();
+
+	/**
+	 * @brief Prune predicate.
+	 * Called for each found directory before descending into it.
+	 * If the predicate returns true, then the directory is still reported,
+	 * but its contents are not walked.
+	 * The predicate is called from the worker threads, possibly concurrently.
+	 */
+	std::function<bool(const walk_entry& entry)> prune;
+
+	/**
+	 * @brief Whether to descend into symbolic links to directories.
+	 * By default the links are reported as entries, but their contents are not walked.
+	 * In case the links are followed, each directory is walked only once, even if it is reachable
+	 * via several paths, this protects from endless loops formed by the links. Directories are identified
+	 * by file system specific identity, e.g. device and inode numbers, see dir_entry_range::dir_id().
+	 * Links are not followed on file systems which do not identify directories.
+	 */
+	bool follow_symlinks = false;
+};
+
+/**
+ * @brief Recursively walk a directory tree.
+ * Traverses the subtree of the directory pointed by the given file object on a number of
+ * worker threads. Each worker has its own queue of directories to list and steals directories
+ * from other workers' queues when its own queue runs empty.
+ * Each worker reads the directories through its own file object spawned from the root
+ * file, so the file implementation has to support spawning.
+ * The root file object must not be modified or opened while this function is running.
+ * The order in which entries are reported is not specified.
+ * @param root - file object pointing to the directory to walk.
+ * @param on_entry - callback which is called for each found entry.
+ *                   The callback is called from the worker threads, possibly concurrently.
+ * @param params - walk parameters.
+ * @throw std::logic_error - if root does not point to a directory.
+ * @throw Any exception thrown by listing a directory, by the prune predicate or by the callback.
+ *        The exception is thrown after all the workers have stopped.
+ */
+void walk(
+	const file& root,
+	const std::function<void(const walk_entry& entry)>& on_entry,
+	const walk_parameters& params = {}
+);
+
+} // namespace papki
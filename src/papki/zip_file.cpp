@@ -27,9 +27,19 @@ SOFTWARE.
 
 #include "zip_file.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <mutex>
 #include <sstream>
+#include <thread>
 
 #include <minizip/unzip.h>
+#include <utki/util.hpp>
+
+#include "util.hpp"
 
 using namespace papki;
 
@@ -37,7 +47,7 @@ namespace {
 
 voidpf ZCALLBACK unzip_open(
 	voidpf opaque, //
-	const char* /* filename */,
+	const void* /* filename */,
 	int mode
 )
 {
@@ -46,7 +56,10 @@ voidpf ZCALLBACK unzip_open(
 
 	switch (mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER) {
 		case ZLIB_FILEFUNC_MODE_READ:
-			f->open(papki::mode::read);
+			// the file can be already opened by zip_file for reading entries without minizip
+			if (!f->is_open()) {
+				f->open(papki::mode::read);
+			}
 			break;
 		default:
 			throw std::invalid_argument(
@@ -106,7 +119,7 @@ int ZCALLBACK unzip_error(
 long ZCALLBACK unzip_seek(
 	voidpf /* opaque */, //
 	voidpf stream,
-	unsigned long offset,
+	ZPOS64_T offset,
 	int origin
 )
 {
@@ -115,91 +128,817 @@ long ZCALLBACK unzip_seek(
 
 	// assume that offset can only be positive, since its type is unsigned
 
+	uint64_t position = 0;
+
 	switch (origin) {
 		case ZLIB_FILEFUNC_SEEK_CUR:
-			f->seek_forward(offset);
-			return 0;
+			position = f->cur_pos() + offset;
+			break;
 		case ZLIB_FILEFUNC_SEEK_END:
+			// minizip seeks to the end to find out the archive size
+			if (auto size = f->size_hint()) {
+				position = *size + offset;
+				break;
+			}
+
+			// the size is unknown, the only way to find the end is to read the whole file
 			f->seek_forward(std::numeric_limits<size_t>::max());
 			return 0;
 		case ZLIB_FILEFUNC_SEEK_SET:
-			f->rewind();
-			f->seek_forward(offset);
-			return 0;
+			position = offset;
+			break;
 		default:
 			return -1;
 	}
+
+	if (f->seek(position) != position) {
+		// tried to seek beyond the end of the archive
+		return -1;
+	}
+	return 0;
 }
 
-long ZCALLBACK unzip_tell(
+ZPOS64_T ZCALLBACK unzip_tell(
 	voidpf /* opaque */, //
 	voidpf stream
 )
 {
 	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
 	auto f = reinterpret_cast<papki::file*>(stream);
-	return long(f->cur_pos());
+	return ZPOS64_T(f->cur_pos());
+}
+
+unzFile open_unzip(papki::file& f)
+{
+	zlib_filefunc64_def ff;
+	ff.opaque = &f;
+	ff.zopen64_file = &unzip_open;
+	ff.zclose_file = &unzip_close;
+	ff.zread_file = &unzip_read;
+	ff.zwrite_file = &unzip_write;
+	ff.zseek64_file = &unzip_seek;
+	ff.zerror_file = &unzip_error;
+	ff.ztell64_file = &unzip_tell;
+
+	unzFile ret = unzOpen2_64(f.path().c_str(), &ff);
+
+	if (!ret) {
+		throw std::runtime_error("zip_file: opening zip file failed");
+	}
+
+	return ret;
 }
 
+// Reusable part of the decompression state of deflated entry: the zlib inflate stream
+// and the buffers. Allocating these and initializing the inflate stream costs more than
+// inflating a typical small entry, so the objects are kept in a per-thread pool and
+// reused across entry opens.
+struct inflate_buffers {
+	// deflate window size, maximal distance of back references
+	constexpr static const size_t window_size = 0x8000; // 32kb
+
+	constexpr static const size_t input_buffer_size = 0x10000; // 64kb
+
+	z_stream strm{};
+
+	std::vector<uint8_t> input_buffer;
+
+	// circular buffer holding last uncompressed bytes
+	std::vector<uint8_t> window;
+
+	inflate_buffers() :
+		input_buffer(input_buffer_size),
+		window(window_size)
+	{
+		// negative window bits value means raw deflate data, without zlib header
+		if (inflateInit2(&this->strm, -MAX_WBITS) != Z_OK) {
+			throw std::runtime_error("zip_file: inflateInit2() failed");
+		}
+	}
+
+	inflate_buffers(const inflate_buffers&) = delete;
+	inflate_buffers& operator=(const inflate_buffers&) = delete;
+
+	inflate_buffers(inflate_buffers&&) = delete;
+	inflate_buffers& operator=(inflate_buffers&&) = delete;
+
+	~inflate_buffers()
+	{
+		inflateEnd(&this->strm);
+	}
+};
+
+class inflate_buffers_pool
+{
+	// Maximal number of idle objects kept per thread. Every opened deflated entry holds
+	// its own object, the pool only keeps the ones released by closed entries.
+	constexpr static const size_t max_size = 4;
+
+	std::vector<std::unique_ptr<inflate_buffers>> idle;
+
+	// the pool is thread local, after it is destroyed the released objects are just freed
+	static thread_local bool destroyed;
+
+	static inflate_buffers_pool& inst()
+	{
+		static thread_local inflate_buffers_pool pool;
+		return pool;
+	}
+
+	inflate_buffers_pool()
+	{
+		// reserve the storage in advance, so that releasing never throws
+		this->idle.reserve(max_size);
+	}
+
+public:
+	inflate_buffers_pool(const inflate_buffers_pool&) = delete;
+	inflate_buffers_pool& operator=(const inflate_buffers_pool&) = delete;
+
+	inflate_buffers_pool(inflate_buffers_pool&&) = delete;
+	inflate_buffers_pool& operator=(inflate_buffers_pool&&) = delete;
+
+	~inflate_buffers_pool()
+	{
+		destroyed = true;
+	}
+
+	static std::unique_ptr<inflate_buffers> acquire()
+	{
+		if (destroyed) {
+			return std::make_unique<inflate_buffers>();
+		}
+
+		auto& idle = inst().idle;
+		if (idle.empty()) {
+			return std::make_unique<inflate_buffers>();
+		}
+
+		auto ret = std::move(idle.back());
+		idle.pop_back();
+
+		if (inflateReset(&ret->strm) != Z_OK) {
+			throw std::runtime_error("zip_file: inflateReset() failed");
+		}
+		// inflateReset() does not touch the input, drop what is left from the previous entry
+		ret->strm.next_in = nullptr;
+		ret->strm.avail_in = 0;
+		return ret;
+	}
+
+	static void release(std::unique_ptr<inflate_buffers> buffers) noexcept
+	{
+		if (!buffers || destroyed) {
+			return;
+		}
+
+		auto& idle = inst().idle;
+		if (idle.size() == idle.capacity()) {
+			return;
+		}
+		idle.push_back(std::move(buffers));
+	}
+};
+
+thread_local bool inflate_buffers_pool::destroyed = false;
+
 } // namespace
 
+struct zip_file::inflate_state {
+	// Inflating can be resumed from any of the checkpoints. A checkpoint is recorded
+	// on a deflate block boundary when at least this number of uncompressed bytes
+	// has been produced since the previous checkpoint.
+	constexpr static const size_t checkpoint_span = 0x100000; // 1mb
+
+	struct checkpoint {
+		uint64_t out_pos;
+
+		// position of the first compressed byte which was not fully consumed
+		uint64_t in_pos;
+
+		// number of bits of the byte preceding in_pos which belong to the next block
+		int bits;
+
+		// last uncompressed bytes before out_pos, up to inflate_buffers::window_size
+		std::vector<uint8_t> window;
+	};
+
+	// position of the entry in the central directory, identifies the entry
+	const uint64_t pos_in_central_dir;
+
+	// offset of the entry's compressed data within the archive
+	const uint64_t data_offset;
+
+	const uint64_t compressed_size;
+	const uint64_t uncompressed_size;
+	const uint32_t expected_crc;
+
+	// Inflate stream and buffers, taken from the per-thread pool when the entry is opened
+	// and returned to the pool when the entry is closed. Null while the entry is closed.
+	std::unique_ptr<inflate_buffers> buffers;
+
+	// number of compressed bytes passed to the inflate stream
+	uint64_t in_pos = 0;
+
+	// number of uncompressed bytes produced by the inflate stream
+	uint64_t out_pos = 0;
+
+	bool stream_end = false;
+
+	// CRC can only be calculated if inflating was started from the beginning of the entry
+	bool crc_valid = true;
+	uint32_t crc = 0;
+
+	// position and fill of the circular buffer holding last uncompressed bytes
+	size_t window_pos = 0;
+	size_t window_fill = 0;
+
+	std::vector<checkpoint> checkpoints;
+
+	inflate_state(const entry_info& entry, uint64_t data_offset) :
+		pos_in_central_dir(entry.pos_in_central_dir),
+		data_offset(data_offset),
+		compressed_size(entry.compressed_size),
+		uncompressed_size(entry.uncompressed_size),
+		expected_crc(entry.crc),
+		buffers(inflate_buffers_pool::acquire())
+	{}
+
+	inflate_state(const inflate_state&) = delete;
+	inflate_state& operator=(const inflate_state&) = delete;
+
+	inflate_state(inflate_state&&) = delete;
+	inflate_state& operator=(inflate_state&&) = delete;
+
+	~inflate_state()
+	{
+		this->release_buffers();
+	}
+
+	void release_buffers() noexcept
+	{
+		inflate_buffers_pool::release(std::move(this->buffers));
+	}
+
+	// reopen the entry, inflating is restarted from the beginning of the entry
+	void reopen(const zip_file& owner)
+	{
+		if (!this->buffers) {
+			this->buffers = inflate_buffers_pool::acquire();
+		}
+		this->restart(owner, nullptr);
+	}
+
+	void refill(const zip_file& owner)
+	{
+		ASSERT(this->buffers->strm.avail_in == 0)
+		ASSERT(this->in_pos < this->compressed_size)
+
+		auto num_bytes_to_read = size_t(std::min(uint64_t(this->buffers->input_buffer.size()), this->compressed_size - this->in_pos));
+		auto num_bytes_read = owner.read_archive_at(
+			this->data_offset + this->in_pos,
+			utki::make_span(this->buffers->input_buffer.data(), num_bytes_to_read)
+		);
+		if (num_bytes_read == 0) {
+			throw std::runtime_error("zip_file: unexpected end of zip file");
+		}
+
+		this->buffers->strm.next_in = this->buffers->input_buffer.data();
+		this->buffers->strm.avail_in = uInt(num_bytes_read);
+		this->in_pos += num_bytes_read;
+	}
+
+	void add_checkpoint()
+	{
+		checkpoint cp;
+		cp.out_pos = this->out_pos;
+		cp.in_pos = this->in_pos - this->buffers->strm.avail_in;
+		cp.bits = this->buffers->strm.data_type & 7; // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+
+		// unroll the circular buffer
+		cp.window.resize(this->window_fill);
+		size_t head_size = std::min(this->window_fill, this->window_pos);
+		size_t tail_size = this->window_fill - head_size;
+		std::copy(
+			std::next(this->buffers->window.begin(), ptrdiff_t(this->buffers->window.size() - tail_size)),
+			this->buffers->window.end(),
+			cp.window.begin()
+		);
+		std::copy(
+			std::next(this->buffers->window.begin(), ptrdiff_t(this->window_pos - head_size)),
+			std::next(this->buffers->window.begin(), ptrdiff_t(this->window_pos)),
+			std::next(cp.window.begin(), ptrdiff_t(tail_size))
+		);
+
+		this->checkpoints.push_back(std::move(cp));
+	}
+
+	// restart inflating from the given checkpoint, or from the beginning of the entry if checkpoint is null
+	void restart(const zip_file& owner, const checkpoint* cp)
+	{
+		if (inflateReset(&this->buffers->strm) != Z_OK) {
+			throw std::runtime_error("zip_file: inflateReset() failed");
+		}
+		this->buffers->strm.avail_in = 0;
+		this->stream_end = false;
+
+		if (!cp) {
+			this->in_pos = 0;
+			this->out_pos = 0;
+			this->window_pos = 0;
+			this->window_fill = 0;
+			this->crc_valid = true;
+			this->crc = uint32_t(crc32(0, nullptr, 0));
+			return;
+		}
+
+		this->in_pos = cp->in_pos;
+		this->out_pos = cp->out_pos;
+		this->crc_valid = false;
+
+		if (cp->bits != 0) {
+			// the checkpoint is in the middle of a byte, feed the remaining bits of that byte to the inflater
+			--this->in_pos;
+			std::array<uint8_t, 1> byte{};
+			if (owner.read_archive_at(this->data_offset + this->in_pos, utki::make_span(byte)) != byte.size()) {
+				throw std::runtime_error("zip_file: unexpected end of zip file");
+			}
+			++this->in_pos;
+			// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+			if (inflatePrime(&this->buffers->strm, cp->bits, byte.front() >> (8 - cp->bits)) != Z_OK) {
+				throw std::runtime_error("zip_file: inflatePrime() failed");
+			}
+		}
+
+		if (!cp->window.empty()) {
+			if (inflateSetDictionary(&this->buffers->strm, cp->window.data(), uInt(cp->window.size())) != Z_OK) {
+				throw std::runtime_error("zip_file: inflateSetDictionary() failed");
+			}
+		}
+
+		ASSERT(cp->window.size() <= this->buffers->window.size())
+		std::copy(cp->window.begin(), cp->window.end(), this->buffers->window.begin());
+		this->window_fill = cp->window.size();
+		this->window_pos = this->window_fill % this->buffers->window.size();
+	}
+
+	// Inflate up to 'size' bytes. If 'dst' is null, the uncompressed data is discarded.
+	size_t inflate_data(const zip_file& owner, uint8_t* dst, size_t size)
+	{
+		size_t num_bytes_produced = 0;
+
+		while (num_bytes_produced != size && !this->stream_end) {
+			if (this->buffers->strm.avail_in == 0 && this->in_pos != this->compressed_size) {
+				this->refill(owner);
+			}
+
+			size_t num_bytes_wanted = std::min(size - num_bytes_produced, this->buffers->window.size() - this->window_pos);
+			uint8_t* out = &this->buffers->window[this->window_pos];
+			this->buffers->strm.next_out = out;
+			this->buffers->strm.avail_out = uInt(num_bytes_wanted);
+
+			// inflate() returns on each deflate block boundary with Z_BLOCK flush mode,
+			// this allows recording checkpoints
+			int ret = inflate(&this->buffers->strm, Z_BLOCK);
+			if (ret != Z_OK && ret != Z_STREAM_END) {
+				std::stringstream ss;
+				ss << "zip_file: inflating failed";
+				if (this->buffers->strm.msg) {
+					ss << ": " << this->buffers->strm.msg;
+				}
+				throw std::runtime_error(ss.str());
+			}
+
+			size_t num_bytes = num_bytes_wanted - this->buffers->strm.avail_out;
+
+			if (dst) {
+				std::memcpy(std::next(dst, ptrdiff_t(num_bytes_produced)), out, num_bytes);
+			}
+			if (this->crc_valid) {
+				this->crc = uint32_t(crc32(this->crc, out, uInt(num_bytes)));
+			}
+
+			this->window_pos = (this->window_pos + num_bytes) % this->buffers->window.size();
+			this->window_fill = std::min(this->window_fill + num_bytes, this->buffers->window.size());
+			this->out_pos += num_bytes;
+			num_bytes_produced += num_bytes;
+
+			if (ret == Z_STREAM_END) {
+				this->stream_end = true;
+				if (this->out_pos != this->uncompressed_size || (this->crc_valid && this->crc != this->expected_crc)) {
+					throw std::runtime_error("zip_file: zip entry data is corrupted");
+				}
+				break;
+			}
+
+			// bit 7 of data_type indicates end of a deflate block, bit 6 indicates the last block
+			// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+			if ((this->buffers->strm.data_type & 128) && !(this->buffers->strm.data_type & 64)) {
+				uint64_t last_checkpoint_pos = this->checkpoints.empty() ? 0 : this->checkpoints.back().out_pos;
+				if (this->out_pos >= last_checkpoint_pos + checkpoint_span) {
+					this->add_checkpoint();
+				}
+			}
+		}
+
+		return num_bytes_produced;
+	}
+
+	void seek(const zip_file& owner, uint64_t pos)
+	{
+		this->seek(owner, pos, this->checkpoints);
+	}
+
+	// Seek using the given checkpoints, they can be recorded by another inflate_state of the same entry.
+	void seek(const zip_file& owner, uint64_t pos, const std::vector<checkpoint>& known_checkpoints)
+	{
+		// find last checkpoint at or before the requested position
+		auto i = std::upper_bound(
+			known_checkpoints.begin(),
+			known_checkpoints.end(),
+			pos,
+			[](uint64_t pos, const checkpoint& cp) {
+				return pos < cp.out_pos;
+			}
+		);
+		const checkpoint* cp = i == known_checkpoints.begin() ? nullptr : &*std::prev(i);
+
+		if (pos < this->out_pos) {
+			this->restart(owner, cp);
+		} else if (cp && cp->out_pos > this->out_pos) {
+			// skipping to the checkpoint is faster than inflating up to it
+			this->restart(owner, cp);
+		}
+
+		ASSERT(this->out_pos <= pos)
+		while (this->out_pos != pos) {
+			auto num_bytes_to_skip = size_t(std::min(pos - this->out_pos, uint64_t(std::numeric_limits<size_t>::max())));
+			if (this->inflate_data(owner, nullptr, num_bytes_to_skip) == 0) {
+				break;
+			}
+		}
+	}
+};
+
 zip_file::zip_file(std::unique_ptr<papki::file> underlying_zip_file, std::string_view path) :
 	papki::file(path),
 	underlying_zip_file(std::move(underlying_zip_file))
 {
-	zlib_filefunc_def ff;
-	ff.opaque = this->underlying_zip_file.operator->();
-	ff.zopen_file = &unzip_open;
-	ff.zclose_file = &unzip_close;
-	ff.zread_file = &unzip_read;
-	ff.zwrite_file = &unzip_write;
-	ff.zseek_file = &unzip_seek;
-	ff.zerror_file = &unzip_error;
-	ff.ztell_file = &unzip_tell;
+	this->handle = open_unzip(*this->underlying_zip_file);
+
+	try {
+		this->directory = this->read_directory();
+	} catch (...) {
+		unzClose(this->handle);
+		throw;
+	}
+}
+
+zip_file::zip_file(
+	std::unique_ptr<papki::file> underlying_zip_file,
+	std::shared_ptr<const archive_directory> directory
+) :
+	underlying_zip_file(std::move(underlying_zip_file)),
+	directory(std::move(directory))
+{
+	ASSERT(this->directory != nullptr)
+}
+
+std::unique_ptr<papki::file> zip_file::spawn()
+{
+	std::unique_ptr<papki::file> zf = this->underlying_zip_file->spawn();
+	zf->set_path(this->underlying_zip_file->path());
 
-	this->handle = unzOpen2(this->underlying_zip_file->path().c_str(), &ff);
+	// NOLINTNEXTLINE(cppcoreguidelines-owning-memory, "private constructor cannot be called by std::make_unique()")
+	std::unique_ptr<zip_file> ret(new zip_file(std::move(zf), this->directory));
+	ret->engine = this->engine;
+	return ret;
+}
 
+void zip_file::set_inflate_engine(std::shared_ptr<const inflate_engine> engine)
+{
+	if (!engine) {
+		throw std::invalid_argument("zip_file::set_inflate_engine(): engine is null");
+	}
+	this->engine = std::move(engine);
+}
+
+void* zip_file::get_handle() const
+{
 	if (!this->handle) {
-		throw std::runtime_error("zip_file: opening zip file failed");
+		this->handle = open_unzip(*this->underlying_zip_file);
+	}
+	return this->handle;
+}
+
+const papki::file& zip_file::archive() const
+{
+	const auto& f = *this->underlying_zip_file;
+
+	if (!f.is_open()) {
+		this->underlying_zip_file->open(papki::mode::read);
+	}
+
+	if (!this->archive_supports_read_at.has_value()) {
+		// files which do not support positional reads throw on any read_at() call
+		try {
+			f.read_at(0, utki::span<uint8_t>());
+			this->archive_supports_read_at = true;
+		} catch (std::runtime_error&) {
+			this->archive_supports_read_at = false;
+		}
+	}
+
+	return f;
+}
+
+size_t zip_file::read_archive_at(uint64_t pos, utki::span<uint8_t> buf) const
+{
+	const auto& f = this->archive();
+
+	if (this->archive_supports_read_at.value()) {
+		return f.read_at(pos, buf);
+	}
+
+	std::lock_guard<std::mutex> lock(this->archive_mutex);
+	if (f.seek(pos) != pos) {
+		return 0;
+	}
+	return f.read(buf);
+}
+
+std::shared_ptr<const zip_file::archive_directory> zip_file::read_directory()
+{
+	auto dir = std::make_shared<archive_directory>();
+
+	unz_global_info64 global_info;
+	if (unzGetGlobalInfo64(this->handle, &global_info) != UNZ_OK) {
+		throw std::runtime_error("zip_file: unz_get_global_info() failed");
+	}
+
+	// entry name length is stored as 16 bit value in the zip format, so the buffer can hold any name
+	std::vector<char> file_name_buf(size_t(std::numeric_limits<uint16_t>::max()) + 1);
+
+	// The entry names are collected to the arena first, the index is filled after that,
+	// because the arena can reallocate while growing, which would invalidate the names in the index.
+	std::vector<std::pair<size_t, entry_info>> entries;
+	entries.reserve(size_t(global_info.number_entry));
+
+	int ret = unzGoToFirstFile(this->handle);
+
+	for (; ret == UNZ_OK; ret = unzGoToNextFile(this->handle)) {
+		unz_file_info64 info;
+
+		if (unzGetCurrentFileInfo64(
+				this->handle,
+				&info,
+				file_name_buf.data(),
+				uLong(file_name_buf.size()),
+				nullptr,
+				0,
+				nullptr,
+				0
+			) != UNZ_OK)
+		{
+			throw std::runtime_error("zip_file: unz_get_current_file_info() failed");
+		}
+
+		unz64_file_pos pos;
+		if (unzGetFilePos64(this->handle, &pos) != UNZ_OK) {
+			throw std::runtime_error("zip_file: unz_get_file_pos() failed");
+		}
+
+		ASSERT(info.size_filename < file_name_buf.size())
+
+		dir->entry_names.append(file_name_buf.data(), size_t(info.size_filename));
+
+		entries.emplace_back(
+			size_t(info.size_filename),
+			entry_info{
+				pos.pos_in_zip_directory,
+				pos.num_of_file,
+				info.compressed_size,
+				info.uncompressed_size,
+				uint32_t(info.crc),
+				unsigned(info.compression_method),
+				(info.flag & 1) != 0 // bit 0 of general purpose flag indicates encryption
+			}
+		);
+	}
+
+	if (ret != UNZ_END_OF_LIST_OF_FILE) {
+		throw std::runtime_error("zip_file: unz_go_to_next_file() failed");
+	}
+
+	dir->index.reserve(entries.size());
+
+	std::string_view names = dir->entry_names;
+	for (const auto& e : entries) {
+		// in case of duplicate entry names the first one wins, same as unzLocateFile() does
+		dir->index.try_emplace(names.substr(0, e.first), e.second);
+		names.remove_prefix(e.first);
+	}
+	ASSERT(names.empty())
+
+	return dir;
+}
+
+const zip_file::entry_info* zip_file::find_entry(std::string_view name) const
+{
+	auto i = this->directory->index.find(name);
+	if (i == this->directory->index.end()) {
+		return nullptr;
 	}
+	return &i->second;
 }
 
 zip_file::~zip_file() noexcept
 {
 	this->close(); // make sure there is no file opened inside zip file
 
-	if (unzClose(this->handle) != UNZ_OK) {
-		ASSERT(false)
+	if (this->handle) {
+		if (unzClose(this->handle) != UNZ_OK) {
+			ASSERT(false)
+		}
+	}
+
+	if (this->underlying_zip_file->is_open()) {
+		this->underlying_zip_file->close();
 	}
 }
 
-void zip_file::open_internal(papki::mode mode)
+const zip_file::entry_info& zip_file::get_entry(std::string_view name) const
 {
-	if (mode != papki::mode::read) {
-		throw std::invalid_argument("illegal mode requested, only READ supported inside ZIP file");
+	if (papki::is_dir(name)) {
+		throw std::logic_error("zip_file: path refers to a directory");
 	}
 
-	if (unzLocateFile(this->handle, this->path().c_str(), 0) != UNZ_OK) {
+	auto entry = this->find_entry(name);
+	if (!entry) {
 		std::stringstream ss;
-		ss << "zip_file::OpenInternal(): file not found: " << this->path();
+		ss << "zip_file: file not found: " << name;
 		throw std::runtime_error(ss.str());
 	}
+	return *entry;
+}
+
+namespace {
+constexpr uint32_t central_header_signature = 0x02014b50;
+constexpr size_t central_header_size = 46;
+constexpr size_t central_header_local_header_offset_pos = 42;
+
+constexpr uint32_t local_header_signature = 0x04034b50;
+constexpr size_t local_header_size = 30;
+constexpr size_t local_header_name_length_pos = 26;
+constexpr size_t local_header_extra_field_length_pos = 28;
+
+uint16_t read_16(const uint8_t* p)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+	return uint16_t(p[0] | (p[1] << 8));
+}
+
+uint32_t read_32(const uint8_t* p)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+	return uint32_t(read_16(p)) | (uint32_t(read_16(p + 2)) << 16);
+}
+
+bool read_exactly(const papki::file& f, uint64_t offset, utki::span<uint8_t> buf)
+{
+	return f.seek(offset) == offset && f.read(buf) == buf.size();
+}
+
+// deflate cannot compress data better than about 1032:1
+constexpr uint64_t max_deflate_ratio = 1032;
+
+// Check if the uncompressed size of the entry claimed by the central directory can be trusted
+// for allocating memory up front, before any of the entry data is read.
+bool is_plausible_uncompressed_size(uint64_t compressed_size, uint64_t uncompressed_size)
+{
+	return compressed_size <= std::numeric_limits<uint64_t>::max() / max_deflate_ratio &&
+		uncompressed_size <= compressed_size * max_deflate_ratio;
+}
+} // namespace
+
+std::optional<uint64_t> zip_file::find_data_offset(const entry_info& entry) const
+{
+	const auto& f = this->archive();
+
+	std::array<uint8_t, central_header_size> central_header{};
+	if (!read_exactly(f, entry.pos_in_central_dir, central_header) ||
+		read_32(central_header.data()) != central_header_signature)
+	{
+		// e.g. there is some data prepended to the archive, so positions are shifted
+		return std::nullopt;
+	}
+
+	uint64_t local_header_offset = read_32(&central_header[central_header_local_header_offset_pos]);
+	if (local_header_offset == std::numeric_limits<uint32_t>::max()) {
+		// the real offset is stored in ZIP64 extra field
+		return std::nullopt;
+	}
 
+	std::array<uint8_t, local_header_size> local_header{};
+	if (!read_exactly(f, local_header_offset, local_header) ||
+		read_32(local_header.data()) != local_header_signature)
 	{
-		unz_file_info zip_file_info;
+		return std::nullopt;
+	}
+
+	return local_header_offset + local_header_size + read_16(&local_header[local_header_name_length_pos]) +
+		read_16(&local_header[local_header_extra_field_length_pos]);
+}
+
+void zip_file::open_internal(papki::mode mode)
+{
+	if (mode != papki::mode::read) {
+		throw std::invalid_argument("illegal mode requested, only READ supported inside ZIP file");
+	}
+
+	const auto& entry = this->get_entry(this->path());
+
+	ASSERT(!this->stored_entry)
+	ASSERT(!this->is_inflating)
+
+	bool is_deflated = entry.compression_method == Z_DEFLATED && !entry.is_encrypted;
+	bool is_stored = entry.compression_method == 0 && !entry.is_encrypted &&
+		entry.compressed_size == entry.uncompressed_size;
+
+	if (is_deflated && this->inflater && this->inflater->pos_in_central_dir == entry.pos_in_central_dir) {
+		// same entry is opened again, reuse the recorded checkpoints
+		this->inflater->reopen(*this);
+		this->is_inflating = true;
+		return;
+	}
 
-		if (unzGetCurrentFileInfo(this->handle, &zip_file_info, nullptr, 0, nullptr, 0, nullptr, 0) != UNZ_OK) {
+	std::optional<uint64_t> offset;
+	if (is_deflated || is_stored) {
+		offset = this->find_data_offset(entry);
+	}
+
+	if (!offset) {
+		void* h = this->get_handle();
+
+		unz64_file_pos pos;
+		pos.pos_in_zip_directory = entry.pos_in_central_dir;
+		pos.num_of_file = entry.num_of_file;
+
+		if (unzGoToFilePos64(h, &pos) != UNZ_OK) {
 			throw std::runtime_error("failed obtaining file info");
 		}
+
+		if (unzOpenCurrentFile(h) != UNZ_OK) {
+			throw std::runtime_error("file opening failed");
+		}
+
+		if (!is_deflated && !is_stored) {
+			// the entry data is read through minizip
+			return;
+		}
+
+		// right after opening the entry minizip points to the beginning of the entry data
+		offset = unzGetCurrentFileZStreamPos64(h);
+
+		// the entry data will not be read through minizip
+		unzCloseCurrentFile(h);
 	}
 
-	if (unzOpenCurrentFile(this->handle) != UNZ_OK) {
-		throw std::runtime_error("file opening failed");
+	if (is_deflated) {
+		this->inflater.reset();
+		this->inflater = std::make_unique<inflate_state>(entry, offset.value());
+		this->is_inflating = true;
+		return;
+	}
+
+	ASSERT(is_stored)
+
+	stored_entry_state stored{offset.value(), entry.compressed_size, 0, std::nullopt};
+
+	if (auto memory = this->archive().memory_view()) {
+		if (stored.data_offset <= memory->size() && stored.size <= memory->size() - stored.data_offset) {
+			stored.memory = memory->subspan(size_t(stored.data_offset), size_t(stored.size));
+		}
 	}
+
+	this->stored_entry = stored;
 }
 
 void zip_file::close_internal() const noexcept
 {
+	if (this->is_inflating) {
+		// the checkpoints are kept, the inflate stream and buffers are returned to the pool
+		this->inflater->release_buffers();
+		this->is_inflating = false;
+		return;
+	}
+
+	if (this->stored_entry) {
+		this->stored_entry.reset();
+		return;
+	}
+
+	ASSERT(this->handle)
 	if (unzCloseCurrentFile(this->handle) == UNZ_CRCERROR) {
 		ASSERT(false, [](auto& o) {
 			o << "zip_file::close(): CRC is not good" << std::endl;
@@ -209,6 +948,18 @@ void zip_file::close_internal() const noexcept
 
 size_t zip_file::read_internal(utki::span<uint8_t> buf) const
 {
+	if (this->stored_entry) {
+		auto& stored = this->stored_entry.value();
+		size_t num_bytes_read = this->read_at_internal(stored.pos, buf);
+		stored.pos += num_bytes_read;
+		return num_bytes_read;
+	}
+
+	if (this->is_inflating) {
+		return this->inflater->inflate_data(*this, buf.data(), buf.size());
+	}
+
+	ASSERT(this->handle)
 	ASSERT(buf.size() <= unsigned(-1))
 	int num_bytes_read = unzReadCurrentFile(this->handle, buf.begin(), unsigned(buf.size()));
 	if (num_bytes_read < 0) {
@@ -219,10 +970,171 @@ size_t zip_file::read_internal(utki::span<uint8_t> buf) const
 	return size_t(num_bytes_read);
 }
 
+size_t zip_file::read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const
+{
+	if (this->is_inflating) {
+		// The inflater of the opened entry is left intact, so that read_at() can be called concurrently.
+		// Separate inflater starts inflating from the nearest checkpoint recorded by reading the entry.
+		inflate_state reader(this->get_entry(this->path()), this->inflater->data_offset);
+		reader.seek(*this, offset, this->inflater->checkpoints);
+		if (reader.out_pos != offset) {
+			return 0;
+		}
+		return reader.inflate_data(*this, buf.data(), buf.size());
+	}
+
+	if (!this->stored_entry) {
+		return this->file::read_at_internal(offset, buf);
+	}
+
+	const auto& stored = this->stored_entry.value();
+	if (offset >= stored.size) {
+		return 0;
+	}
+	size_t num_bytes_to_read = size_t(std::min(uint64_t(buf.size()), stored.size - offset));
+
+	if (stored.memory) {
+		std::memcpy(buf.data(), &stored.memory.value()[size_t(offset)], num_bytes_to_read);
+		return num_bytes_to_read;
+	}
+
+	return this->read_archive_at(stored.data_offset + offset, buf.subspan(0, num_bytes_to_read));
+}
+
+size_t zip_file::seek_forward_internal(size_t num_bytes_to_seek) const
+{
+	if (this->is_inflating) {
+		uint64_t cur_pos = this->inflater->out_pos;
+		uint64_t pos =
+			cur_pos + std::min(uint64_t(num_bytes_to_seek), std::numeric_limits<uint64_t>::max() - cur_pos);
+		this->inflater->seek(*this, pos);
+		return size_t(this->inflater->out_pos - cur_pos);
+	}
+
+	if (!this->stored_entry) {
+		return this->file::seek_forward_internal(num_bytes_to_seek);
+	}
+
+	auto& stored = this->stored_entry.value();
+	ASSERT(stored.pos <= stored.size)
+	num_bytes_to_seek = size_t(std::min(stored.size - stored.pos, uint64_t(num_bytes_to_seek)));
+	stored.pos += num_bytes_to_seek;
+	return num_bytes_to_seek;
+}
+
+size_t zip_file::seek_backward_internal(size_t num_bytes_to_seek) const
+{
+	if (this->is_inflating) {
+		uint64_t cur_pos = this->inflater->out_pos;
+		this->inflater->seek(*this, cur_pos - std::min(uint64_t(num_bytes_to_seek), cur_pos));
+		return size_t(cur_pos - this->inflater->out_pos);
+	}
+
+	if (!this->stored_entry) {
+		return this->file::seek_backward_internal(num_bytes_to_seek);
+	}
+
+	auto& stored = this->stored_entry.value();
+	num_bytes_to_seek = size_t(std::min(stored.pos, uint64_t(num_bytes_to_seek)));
+	stored.pos -= num_bytes_to_seek;
+	return num_bytes_to_seek;
+}
+
+void zip_file::rewind_internal() const
+{
+	if (this->is_inflating) {
+		this->inflater->seek(*this, 0);
+		return;
+	}
+
+	if (!this->stored_entry) {
+		this->file::rewind_internal();
+		return;
+	}
+
+	this->stored_entry.value().pos = 0;
+}
+
+std::optional<utki::span<const uint8_t>> zip_file::memory_view_internal() const
+{
+	if (!this->stored_entry) {
+		return std::nullopt;
+	}
+	return this->stored_entry.value().memory;
+}
+
+std::optional<uint64_t> zip_file::size_hint_internal() const
+{
+	auto entry = this->find_entry(this->path());
+	if (!entry || !is_plausible_uncompressed_size(entry->compressed_size, entry->uncompressed_size)) {
+		return std::nullopt;
+	}
+	return entry->uncompressed_size;
+}
+
+std::vector<uint8_t> zip_file::load_internal(size_t max_bytes_to_load) const
+{
+	// Deflated entry of known size is inflated by the inflate engine in one go straight into the resulting buffer,
+	// bypassing the window which is used for reading the entry in pieces.
+	// Implausibly big uncompressed size is not allocated up front, such entry is read in growing chunks.
+	if (!this->is_inflating || this->inflater->in_pos != 0 ||
+		this->inflater->uncompressed_size > max_bytes_to_load ||
+		this->inflater->compressed_size > std::numeric_limits<size_t>::max() ||
+		!is_plausible_uncompressed_size(this->inflater->compressed_size, this->inflater->uncompressed_size))
+	{
+		return this->file::load_internal(max_bytes_to_load);
+	}
+
+	const auto& inflater = *this->inflater;
+	const auto& f = this->archive();
+
+	std::vector<uint8_t> ret(size_t(inflater.uncompressed_size));
+
+	// in case the archive resides in memory the compressed data is passed to the engine directly from there
+	if (auto memory = f.memory_view();
+		memory && inflater.data_offset <= memory->size() &&
+		inflater.compressed_size <= memory->size() - inflater.data_offset)
+	{
+		this->engine->inflate(
+			memory->subspan(size_t(inflater.data_offset), size_t(inflater.compressed_size)),
+			utki::make_span(ret)
+		);
+	} else {
+		// the compressed data is passed to the engine in pieces through the input buffer of the entry
+		auto& input_buffer = inflater.buffers->input_buffer;
+		uint64_t in_pos = 0;
+		this->engine->inflate_streamed(
+			[&]() {
+				auto num_bytes_to_read =
+					size_t(std::min(uint64_t(input_buffer.size()), inflater.compressed_size - in_pos));
+				if (num_bytes_to_read == 0) {
+					return utki::span<const uint8_t>();
+				}
+				auto num_bytes_read = this->read_archive_at(
+					inflater.data_offset + in_pos,
+					utki::make_span(input_buffer.data(), num_bytes_to_read)
+				);
+				if (num_bytes_read == 0) {
+					throw std::runtime_error("zip_file: unexpected end of zip file");
+				}
+				in_pos += num_bytes_read;
+				return utki::span<const uint8_t>(input_buffer.data(), num_bytes_read);
+			},
+			utki::make_span(ret)
+		);
+	}
+
+	if (update_crc32(0, ret) != inflater.expected_crc) {
+		throw std::runtime_error("zip_file: zip entry data is corrupted");
+	}
+
+	return ret;
+}
+
 bool zip_file::exists() const
 {
 	if (this->is_dir()) {
-		return this->file::exists();
+		return this->find_dir(this->path()) != nullptr;
 	}
 
 	if (this->path().size() == 0) {
@@ -233,91 +1145,283 @@ bool zip_file::exists() const
 		return true;
 	}
 
-	return unzLocateFile(this->handle, this->path().c_str(), 0) == UNZ_OK;
+	return this->find_entry(this->path()) != nullptr;
 }
 
-std::vector<std::string> zip_file::list_dir(size_t max_entries) const
+uint64_t zip_file::size() const
 {
-	if (!this->is_dir()) {
-		throw std::logic_error("zip_file::list_dir(): this is not a directory");
-	}
+	return this->get_entry(this->path()).uncompressed_size;
+}
 
-	// if path refers to directory then there should be no files opened
-	ASSERT(!this->is_open())
+uint64_t zip_file::compressed_size() const
+{
+	return this->get_entry(this->path()).compressed_size;
+}
 
-	if (!this->handle) {
-		throw std::logic_error("zip_file::list_dir(): zip file is not opened");
+void zip_file::load_entries(
+	utki::span<const std::string> paths,
+	const std::function<void(size_t index, std::vector<uint8_t>&& data)>& on_loaded,
+	unsigned num_threads
+) const
+{
+	if (paths.empty()) {
+		return;
 	}
 
-	std::vector<std::string> files;
+	if (num_threads == 0) {
+		num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	num_threads = unsigned(std::min(size_t(num_threads), paths.size()));
 
-	// for every file, check if it is in the current directory
-	{
-		// move to first file
-		int ret = unzGoToFirstFile(this->handle);
+	std::atomic<size_t> next_index{0};
 
-		if (ret != UNZ_OK) {
-			throw std::runtime_error("zip_file::list_dir(): unz_go_to_first_file() failed.");
-		}
+	std::mutex error_mutex;
+	std::exception_ptr error;
 
-		// NOLINTNEXTLINE(cppcoreguidelines-avoid-do-while)
-		do {
-			std::array<char, std::numeric_limits<char>::max()> file_name_buf{};
-
-			if (unzGetCurrentFileInfo(
-					this->handle,
-					nullptr,
-					file_name_buf.data(),
-					uLong(file_name_buf.size()),
-					nullptr,
-					0,
-					nullptr,
-					0
-				) != UNZ_OK)
-			{
-				throw std::runtime_error("zip_file::list_dir(): unz_get_current_file_info() failed.");
-			}
+	auto worker = [&]() {
+		try {
+			// spawned zip_file shares the parsed central directory, so spawning is cheap
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast, "spawning does not modify this object")
+			auto f = const_cast<zip_file*>(this)->spawn();
 
-			file_name_buf[file_name_buf.size() - 1] = 0; // null-terminate, just to be on a safe side
+			for (size_t i = next_index++; i < paths.size(); i = next_index++) {
+				f->set_path(paths[i]);
 
-			std::string filename(file_name_buf.data());
+				auto data = f->load();
+				if (data.size() != f->size()) {
+					std::stringstream ss;
+					ss << "zip_file::load_entries(): reading entry failed: " << paths[i];
+					throw std::runtime_error(ss.str());
+				}
 
-			if (filename.size() <= this->path().size()) {
-				continue;
+				on_loaded(i, std::move(data));
 			}
+		} catch (...) {
+			// make other workers to stop
+			next_index = paths.size();
 
-			// check if full file path starts with the this->path() string
-			const std::string& cur_path =
-				this->path().compare(0, 2, "./") == 0 ? this->path().substr(2) : this->path(); // remove leading "./"
-			if (filename.compare(0, cur_path.size(), cur_path) != 0) {
-				continue;
+			std::lock_guard<std::mutex> lock(error_mutex);
+			if (!error) {
+				error = std::current_exception();
 			}
+		}
+	};
 
-			ASSERT(filename.size() > cur_path.size())
-			std::string subfilename(filename, cur_path.size(), filename.size() - cur_path.size());
-
-			size_t slash_pos = subfilename.find_first_of('/');
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(num_threads - 1);
 
-			if (slash_pos == std::string::npos) {
-				files.push_back(subfilename);
-				continue;
+		try {
+			for (unsigned t = 1; t < num_threads; ++t) {
+				threads.emplace_back(worker);
 			}
-
-			// if we get here then we need to add a directory
-			ASSERT(subfilename.size() >= slash_pos + 1)
-			if (slash_pos == subfilename.size() - 1) {
-				files.push_back(std::move(subfilename));
+		} catch (...) {
+			next_index = paths.size();
+			for (auto& t : threads) {
+				t.join();
 			}
+			throw;
+		}
 
-			if (files.size() == max_entries) {
-				break;
+		// the calling thread is one of the workers
+		worker();
+
+		for (auto& t : threads) {
+			t.join();
+		}
+	}
+
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+std::vector<std::vector<uint8_t>> zip_file::load_entries(utki::span<const std::string> paths, unsigned num_threads)
+	const
+{
+	std::vector<std::vector<uint8_t>> ret(paths.size());
+
+	this->load_entries(
+		paths,
+		[&ret](size_t index, std::vector<uint8_t>&& data) {
+			ret[index] = std::move(data);
+		},
+		num_threads
+	);
+
+	return ret;
+}
+
+void zip_file::archive_directory::build_dir_tree() const
+{
+	// the index does not preserve the central directory order, restore it
+	std::vector<const decltype(this->index)::value_type*> entries;
+	entries.reserve(this->index.size());
+	for (const auto& e : this->index) {
+		entries.push_back(&e);
+	}
+	std::sort(entries.begin(), entries.end(), [](const auto* a, const auto* b) {
+		return a->second.num_of_file < b->second.num_of_file;
+	});
+
+	auto& tree = this->dir_tree;
+
+	// root directory
+	tree.try_emplace(std::string_view());
+
+	for (const auto* e : entries) {
+		std::string_view name = e->first;
+
+		// add all the directories along the entry path, including implicit ones
+		size_t parent_end = 0;
+		for (size_t slash_pos = name.find('/'); slash_pos != std::string_view::npos;
+			 slash_pos = name.find('/', parent_end))
+		{
+			if (tree.try_emplace(name.substr(0, slash_pos + 1)).second) {
+				// the directory is seen for the first time, add it to its parent
+				tree[name.substr(0, parent_end)].children.push_back(
+					dir_node::child{name.substr(parent_end, slash_pos + 1 - parent_end), nullptr}
+				);
 			}
-		} while ((ret = unzGoToNextFile(this->handle)) == UNZ_OK);
+			parent_end = slash_pos + 1;
+		}
+
+		if (parent_end != name.size()) {
+			tree[name.substr(0, parent_end)].children.push_back(
+				dir_node::child{name.substr(parent_end), &e->second}
+			);
+		}
+	}
+}
+
+const zip_file::dir_node* zip_file::find_dir(std::string_view path) const
+{
+	ASSERT(papki::is_dir(path))
+
+	// remove leading "./"
+	if (path.compare(0, 2, "./") == 0) {
+		path.remove_prefix(2);
+	}
+
+	std::call_once(this->directory->dir_tree_once, [this]() {
+		this->directory->build_dir_tree();
+	});
+	const auto& tree = this->directory->dir_tree;
+
+	auto i = tree.find(path);
+	if (i == tree.end()) {
+		return nullptr;
+	}
+	return &i->second;
+}
+
+namespace {
+// Yields the children of a zip archive directory.
+// Holds iterators into the directory tree, so it must not outlive the zip_file it was created from.
+template <typename child_iterator_type>
+class zip_dir_reader : public dir_reader
+{
+	child_iterator_type cur;
+	child_iterator_type end;
+
+	dir_entry entry;
+
+public:
+	zip_dir_reader(child_iterator_type begin, child_iterator_type end) :
+		cur(begin),
+		end(end)
+	{}
+
+	const dir_entry* next() override
+	{
+		if (this->cur == this->end) {
+			return nullptr;
+		}
+
+		const auto& c = *this->cur;
+		++this->cur;
 
-		if (ret != UNZ_END_OF_LIST_OF_FILE && ret != UNZ_OK) {
-			throw std::runtime_error("zip_file::list_dir(): unz_go_to_next_file() failed.");
+		this->entry.name = c.name;
+		this->entry.is_dir = c.info == nullptr;
+		if (c.info) {
+			this->entry.size = c.info->uncompressed_size;
+		} else {
+			this->entry.size.reset();
 		}
+		return &this->entry;
+	}
+};
+} // namespace
+
+dir_entry_range zip_file::dir_entries() const
+{
+	if (!this->is_dir()) {
+		throw std::logic_error("zip_file::dir_entries(): this is not a directory");
+	}
+
+	const auto* dir = this->find_dir(this->path());
+	if (!dir) {
+		return dir_entry_range(nullptr);
+	}
+
+	using iterator_type = decltype(dir->children)::const_iterator;
+	return dir_entry_range(std::make_unique<zip_dir_reader<iterator_type>>(dir->children.begin(), dir->children.end()));
+}
+
+std::vector<std::string> zip_file::list_dir(size_t max_entries) const
+{
+	if (!this->is_dir()) {
+		throw std::logic_error("zip_file::list_dir(): this is not a directory");
+	}
+
+	// if path refers to directory then there should be no files opened
+	ASSERT(!this->is_open())
+
+	const auto* dir = this->find_dir(this->path());
+	if (!dir) {
+		return {};
+	}
+
+	size_t num_entries = dir->children.size();
+	if (max_entries != 0) {
+		num_entries = std::min(num_entries, max_entries);
+	}
+
+	std::vector<std::string> files;
+	files.reserve(num_entries);
+
+	for (size_t i = 0; i != num_entries; ++i) {
+		files.emplace_back(dir->children[i].name);
 	}
 
 	return files;
 }
+
+dir_listing zip_file::list_dir_compact(size_t max_entries) const
+{
+	if (!this->is_dir()) {
+		throw std::logic_error("zip_file::list_dir(): this is not a directory");
+	}
+
+	const auto* dir = this->find_dir(this->path());
+	if (!dir) {
+		return {};
+	}
+
+	size_t num_entries = dir->children.size();
+	if (max_entries != 0) {
+		num_entries = std::min(num_entries, max_entries);
+	}
+
+	size_t num_chars = 0;
+	for (size_t i = 0; i != num_entries; ++i) {
+		num_chars += dir->children[i].name.size();
+	}
+
+	dir_listing ret;
+	ret.reserve(num_entries, num_chars);
+	for (size_t i = 0; i != num_entries; ++i) {
+		ret.push_back(dir->children[i].name);
+	}
+	return ret;
+}
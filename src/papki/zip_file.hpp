@@ -27,11 +27,17 @@ SOFTWARE.
 
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include <utki/debug.hpp>
 
 #include "file.hpp"
+#include "inflate_engine.hpp"
 
 namespace papki {
 
@@ -40,7 +46,117 @@ class zip_file : public papki::file
 {
 	std::unique_ptr<papki::file> underlying_zip_file;
 
-	void* handle = nullptr;
+	// Minizip handle. Entries which are stored or deflated are read by zip_file itself,
+	// minizip is only needed for reading other entries, so the handle is opened lazily.
+	mutable void* handle = nullptr;
+
+	void* get_handle() const;
+
+	// Underlying zip file, opened for reading if it is not yet.
+	const papki::file& archive() const;
+
+	// Whether the underlying zip file supports positional reads, it is found out when the underlying zip file
+	// is opened. Entries are opened before reading them, so the value is never changed by concurrent reads.
+	mutable std::optional<bool> archive_supports_read_at;
+
+	// serializes reads from the underlying zip file in case it does not support positional reads
+	mutable std::mutex archive_mutex;
+
+	// Read data of the underlying zip file from the given position. Can be called concurrently.
+	size_t read_archive_at(uint64_t pos, utki::span<uint8_t> buf) const;
+
+	// central directory record of a single zip entry
+	struct entry_info {
+		// position of the entry in the central directory, as understood by minizip
+		uint64_t pos_in_central_dir;
+		uint64_t num_of_file;
+
+		uint64_t compressed_size;
+		uint64_t uncompressed_size;
+		uint32_t crc;
+		unsigned compression_method;
+		bool is_encrypted;
+	};
+
+	// Directory of the archive. Children are listed in the order of their first
+	// appearance in the central directory. Names of subdirectories have trailing '/'.
+	struct dir_node {
+		struct child {
+			std::string_view name;
+
+			// nullptr for subdirectories
+			const entry_info* info;
+		};
+
+		std::vector<child> children;
+	};
+
+	// Directory path, without leading "./", to directory node. The root directory has empty path.
+	// The tree includes implicit directories, i.e. the ones which have no entries of their own
+	// in the archive, but only appear as part of the entry paths. All the strings are views into
+	// the entry names.
+	using dir_tree_type = std::unordered_map<std::string_view, dir_node>;
+
+	// Parsed central directory of the archive. It is read once when zip_file is constructed
+	// and never changes after that, so it is shared by all the zip_file objects spawned from
+	// each other. Spawned zip_file objects only have their own reading state.
+	struct archive_directory {
+		// Names of all the entries, stored one after another without separators.
+		// The name length is stored in the zip format, so it is taken from there and there
+		// is no limit on the name length, other than the one of the zip format itself.
+		std::string entry_names;
+
+		// entry name to entry info, the entry names are views into the entry_names
+		std::unordered_map<std::string_view, entry_info> index;
+
+		// built lazily on first directory listing
+		mutable std::once_flag dir_tree_once;
+		mutable dir_tree_type dir_tree;
+
+		void build_dir_tree() const;
+	};
+
+	std::shared_ptr<const archive_directory> directory;
+
+	std::shared_ptr<const archive_directory> read_directory();
+
+	const entry_info* find_entry(std::string_view name) const;
+
+	const entry_info& get_entry(std::string_view name) const;
+
+	const dir_node* find_dir(std::string_view path) const;
+
+	// Offset of the entry data within the archive, read from the entry headers.
+	// Returns std::nullopt if the offset cannot be obtained without minizip, e.g. in case of ZIP64 archive.
+	std::optional<uint64_t> find_data_offset(const entry_info& entry) const;
+
+	// Opened entry which is stored without compression. It is read directly from the underlying
+	// zip file, not through minizip. In case the underlying zip file resides in memory the entry
+	// data is served directly from the underlying memory.
+	struct stored_entry_state {
+		uint64_t data_offset;
+		uint64_t size;
+		uint64_t pos;
+		std::optional<utki::span<const uint8_t>> memory;
+	};
+
+	mutable std::optional<stored_entry_state> stored_entry;
+
+	// Decompression state of deflated entry. Deflated entries are inflated by
+	// zip_file itself, not by minizip, so that inflate checkpoints can be recorded
+	// while reading and backward seeks can resume inflating from the nearest checkpoint.
+	// The state, including the checkpoints, is kept after closing the entry, so
+	// the checkpoints are reused if the same entry is opened again. The inflate stream
+	// and the read buffers are only held while the entry is open, they are taken from
+	// a per-thread pool and reused across entry opens.
+	struct inflate_state;
+	mutable std::unique_ptr<inflate_state> inflater;
+	mutable bool is_inflating = false;
+
+	// decoder used for loading whole deflated entries
+	std::shared_ptr<const inflate_engine> engine = zlib_inflate_engine::get();
+
+	zip_file(std::unique_ptr<papki::file> underlying_zip_file, std::shared_ptr<const archive_directory> directory);
 
 public:
 	zip_file(std::unique_ptr<papki::file> underlying_zip_file, std::string_view path = std::string_view());
@@ -56,15 +172,87 @@ public:
 	void open_internal(papki::mode mode) override;
 	void close_internal() const noexcept override;
 	size_t read_internal(utki::span<uint8_t> buf) const override;
+	size_t read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const override;
+	size_t seek_forward_internal(size_t num_bytes_to_seek) const override;
+	size_t seek_backward_internal(size_t num_bytes_to_seek) const override;
+	void rewind_internal() const override;
+	std::optional<uint64_t> size_hint_internal() const override;
+	std::optional<utki::span<const uint8_t>> memory_view_internal() const override;
+	std::vector<uint8_t> load_internal(size_t max_bytes_to_load) const override;
 	bool exists() const override;
 	std::vector<std::string> list_dir(size_t max_entries = 0) const override;
+	dir_listing list_dir_compact(size_t max_entries = std::numeric_limits<size_t>::max()) const override;
+	dir_entry_range dir_entries() const override;
+
+	/**
+	 * @brief Get uncompressed size of the zip entry.
+	 * The size is taken from the zip central directory, the entry is not decompressed.
+	 * @return uncompressed size of the entry.
+	 * @throw std::logic_error - if path refers to a directory.
+	 * @throw std::runtime_error - if entry is not found in the zip file.
+	 */
+	uint64_t size() const override;
+
+	/**
+	 * @brief Get compressed size of the zip entry.
+	 * The size is taken from the zip central directory.
+	 * @return compressed size of the entry.
+	 * @throw std::logic_error - if path refers to a directory.
+	 * @throw std::runtime_error - if entry is not found in the zip file.
+	 */
+	uint64_t compressed_size() const;
+
+	/**
+	 * @brief Set inflate engine.
+	 * The inflate engine is used by load() to decompress whole deflated entries.
+	 * Reading deflated entries in pieces always uses zlib.
+	 * Spawned zip_file objects, including the ones used by load_entries(), use the same engine.
+	 * By default zlib_inflate_engine is used.
+	 * @param engine - inflate engine to use.
+	 * @throw std::invalid_argument - if engine is null.
+	 */
+	void set_inflate_engine(std::shared_ptr<const inflate_engine> engine);
+
+	/**
+	 * @brief Load several zip entries concurrently.
+	 * Decompresses the given entries on a number of worker threads. Each worker
+	 * reads the archive through its own file object spawned from the underlying
+	 * zip file, so the underlying file implementation has to support spawning.
+	 * The path of this zip_file object is not used. The zip_file object must not
+	 * be modified or opened while this function is running.
+	 * @param paths - paths of the entries to load.
+	 * @param on_loaded - callback which is called for each loaded entry with the index
+	 *                    of the entry in the 'paths' list and the entry data. The callback
+	 *                    is called from the worker threads, possibly concurrently.
+	 * @param num_threads - number of worker threads, 0 means number of hardware threads.
+	 * @throw std::runtime_error - if any of the entries is not found or could not be decompressed.
+	 *                             The exception is thrown after all the workers have stopped.
+	 */
+	void load_entries(
+		utki::span<const std::string> paths,
+		const std::function<void(size_t index, std::vector<uint8_t>&& data)>& on_loaded,
+		unsigned num_threads = 0
+	) const;
+
+	/**
+	 * @brief Load several zip entries concurrently.
+	 * Same as load_entries() with callback, but collects the loaded data.
+	 * @param paths - paths of the entries to load.
+	 * @param num_threads - number of worker threads, 0 means number of hardware threads.
+	 * @return Data of the loaded entries, in the same order as 'paths'.
+	 * @throw std::runtime_error - if any of the entries is not found or could not be decompressed.
+	 */
+	std::vector<std::vector<uint8_t>> load_entries(utki::span<const std::string> paths, unsigned num_threads = 0)
+		const;
 
-	std::unique_ptr<papki::file> spawn() override
-	{
-		std::unique_ptr<papki::file> zf = this->underlying_zip_file->spawn();
-		zf->set_path(this->underlying_zip_file->path());
-		return std::make_unique<zip_file>(std::move(zf));
-	}
+	/**
+	 * @brief Spawn zip_file object for the same archive.
+	 * The spawned object shares the parsed central directory with this object,
+	 * so spawning does not read the archive again. The underlying zip file is spawned too,
+	 * so the spawned object can be used independently, e.g. from another thread.
+	 * @return Spawned zip_file object.
+	 */
+	std::unique_ptr<papki::file> spawn() override;
 };
 
 } // namespace papki
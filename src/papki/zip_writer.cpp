@@ -0,0 +1,421 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#include "zip_writer.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+#include <utki/debug.hpp>
+#include <zlib.h>
+
+#include "util.hpp"
+
+using namespace papki;
+
+namespace {
+constexpr uint32_t local_header_signature = 0x04034b50;
+constexpr uint32_t data_descriptor_signature = 0x08074b50;
+constexpr uint32_t central_header_signature = 0x02014b50;
+constexpr uint32_t end_of_central_dir_signature = 0x06054b50;
+
+// version 2.0 of the zip format is needed for deflate and directories
+constexpr uint16_t version_needed = 20;
+
+// bit 3, CRC and sizes are stored in the data descriptor after the entry data
+constexpr uint16_t flag_data_descriptor = 1 << 3;
+
+// bit 11, entry name is UTF-8 encoded
+constexpr uint16_t flag_utf8 = 1 << 11;
+
+constexpr uint16_t compression_method_store = 0;
+constexpr uint16_t compression_method_deflate = 8;
+
+// MS-DOS time and date of 1980-01-01 00:00:00
+constexpr uint16_t dos_time = 0;
+constexpr uint16_t dos_date = (1 << 5) | 1;
+
+// MS-DOS directory attribute
+constexpr uint32_t external_attributes_dir = 0x10;
+
+// Maximal values of 0xffff and 0xffffffff mean that the actual values are stored in ZIP64 records,
+// so these cannot be used.
+constexpr uint64_t max_entries = std::numeric_limits<uint16_t>::max() - 1;
+constexpr uint64_t max_size = std::numeric_limits<uint32_t>::max() - 1;
+
+void put_16(std::vector<uint8_t>& buf, uint16_t value)
+{
+	buf.push_back(uint8_t(value & 0xff));
+	buf.push_back(uint8_t(value >> 8));
+}
+
+void put_32(std::vector<uint8_t>& buf, uint32_t value)
+{
+	put_16(buf, uint16_t(value & 0xffff));
+	put_16(buf, uint16_t(value >> 16));
+}
+
+void put_string(std::vector<uint8_t>& buf, std::string_view str)
+{
+	buf.insert(buf.end(), str.begin(), str.end());
+}
+
+uint32_t check_size(uint64_t size)
+{
+	if (size > max_size) {
+		throw std::runtime_error("zip_writer: archive is too big, ZIP64 is not supported");
+	}
+	return uint32_t(size);
+}
+} // namespace
+
+struct zip_writer::deflate_state {
+	constexpr static const size_t output_buffer_size = 0x10000; // 64kb
+
+	z_stream strm{};
+
+	std::vector<uint8_t> output_buffer;
+
+	deflate_state(unsigned level) :
+		output_buffer(output_buffer_size)
+	{
+		// negative window bits value means raw deflate data, without zlib header
+		if (deflateInit2(&this->strm, int(level), Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+			throw std::runtime_error("zip_writer: deflateInit2() failed");
+		}
+	}
+
+	deflate_state(const deflate_state&) = delete;
+	deflate_state& operator=(const deflate_state&) = delete;
+
+	deflate_state(deflate_state&&) = delete;
+	deflate_state& operator=(deflate_state&&) = delete;
+
+	~deflate_state()
+	{
+		deflateEnd(&this->strm);
+	}
+};
+
+zip_writer::zip_writer(std::unique_ptr<papki::file> sink, unsigned deflate_level) :
+	sink(std::move(sink)),
+	deflate_level(deflate_level)
+{
+	if (!this->sink) {
+		throw std::logic_error("zip_writer::zip_writer(): sink is nullptr");
+	}
+
+	if (this->deflate_level > Z_BEST_COMPRESSION) {
+		throw std::logic_error("zip_writer::zip_writer(): deflate level is greater than 9");
+	}
+
+	this->sink->open(papki::mode::create);
+}
+
+zip_writer::~zip_writer() noexcept
+{
+	if (!this->sink) {
+		return;
+	}
+
+	try {
+		this->finish();
+	} catch (...) {
+		// the archive is not complete, but there is no way to report that from destructor
+	}
+}
+
+void zip_writer::write_to_sink(utki::span<const uint8_t> data)
+{
+	if (this->sink->write(data) != data.size()) {
+		throw std::runtime_error("zip_writer: could not write all the data to the sink");
+	}
+	this->offset += data.size();
+}
+
+void zip_writer::begin_entry(std::string_view name, method compression)
+{
+	this->start_entry(name, compression, std::nullopt);
+}
+
+void zip_writer::start_entry(
+	std::string_view name,
+	method compression,
+	std::optional<utki::span<const uint8_t>> stored_data
+)
+{
+	if (!this->sink) {
+		throw std::logic_error("zip_writer::begin_entry(): archive is finished");
+	}
+
+	if (name.empty() || name.front() == '/') {
+		throw std::logic_error("zip_writer::begin_entry(): entry name is empty or starts with '/'");
+	}
+
+	if (name.size() > std::numeric_limits<uint16_t>::max()) {
+		throw std::logic_error("zip_writer::begin_entry(): entry name is too long");
+	}
+
+	this->end_entry();
+
+	if (this->entries.size() >= max_entries) {
+		throw std::runtime_error("zip_writer::begin_entry(): too many entries, ZIP64 is not supported");
+	}
+
+	bool is_dir = papki::is_dir(name);
+
+	if (is_dir) {
+		compression = method::store;
+	}
+
+	// the entry is recorded only after its local header is written, so that failed entry does not get into
+	// the central directory
+	entry_record e{
+		std::string(name),
+		uint16_t(is_dir ? flag_utf8 : flag_utf8 | flag_data_descriptor),
+		compression == method::deflate ? compression_method_deflate : compression_method_store,
+		0,
+		0,
+		0,
+		this->offset
+	};
+
+	check_size(e.local_header_offset);
+
+	if (stored_data.has_value()) {
+		ASSERT(compression == method::store && !is_dir)
+		e.flags = flag_utf8;
+		e.crc = update_crc32(0, stored_data.value());
+		e.compressed_size = stored_data.value().size();
+		e.uncompressed_size = stored_data.value().size();
+	}
+
+	std::vector<uint8_t> header;
+	header.reserve(30 + name.size());
+	put_32(header, local_header_signature);
+	put_16(header, version_needed);
+	put_16(header, e.flags);
+	put_16(header, e.compression_method);
+	put_16(header, dos_time);
+	put_16(header, dos_date);
+	// CRC and sizes are zero in case these are stored in the data descriptor
+	put_32(header, e.crc);
+	put_32(header, check_size(e.compressed_size));
+	put_32(header, check_size(e.uncompressed_size));
+	put_16(header, uint16_t(name.size()));
+	put_16(header, 0); // extra field length
+	put_string(header, name);
+
+	this->write_to_sink(header);
+
+	this->entries.push_back(std::move(e));
+
+	if (compression == method::deflate) {
+		if (this->deflater) {
+			if (deflateReset(&this->deflater->strm) != Z_OK) {
+				throw std::runtime_error("zip_writer: deflateReset() failed");
+			}
+		} else {
+			this->deflater = std::make_unique<deflate_state>(this->deflate_level);
+		}
+	}
+
+	this->is_entry_open = true;
+}
+
+void zip_writer::write_compressed(utki::span<const uint8_t> data, bool finish)
+{
+	ASSERT(this->deflater != nullptr)
+	ASSERT(!this->entries.empty())
+
+	auto& e = this->entries.back();
+	auto& strm = this->deflater->strm;
+	auto& out = this->deflater->output_buffer;
+
+	// the data can be longer than zlib can take at once, so feed it by chunks
+	for (;;) {
+		size_t chunk_size = std::min(data.size(), size_t(std::numeric_limits<uInt>::max()));
+		bool is_last_chunk = chunk_size == data.size();
+
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast, "zlib API requires non-const input")
+		strm.next_in = const_cast<Bytef*>(data.data());
+		strm.avail_in = uInt(chunk_size);
+
+		int flush = finish && is_last_chunk ? Z_FINISH : Z_NO_FLUSH;
+
+		// NOLINTNEXTLINE(cppcoreguidelines-avoid-do-while)
+		do {
+			strm.next_out = out.data();
+			strm.avail_out = uInt(out.size());
+
+			if (deflate(&strm, flush) == Z_STREAM_ERROR) {
+				throw std::runtime_error("zip_writer: deflate() failed");
+			}
+
+			size_t num_bytes = out.size() - strm.avail_out;
+			this->write_to_sink(utki::make_span(out.data(), num_bytes));
+			e.compressed_size += num_bytes;
+		} while (strm.avail_out == 0);
+
+		ASSERT(strm.avail_in == 0)
+
+		if (is_last_chunk) {
+			break;
+		}
+		data = data.subspan(chunk_size);
+	}
+}
+
+void zip_writer::write(utki::span<const uint8_t> data)
+{
+	if (!this->is_entry_open) {
+		throw std::logic_error("zip_writer::write(): no entry is being written");
+	}
+
+	ASSERT(!this->entries.empty())
+	auto& e = this->entries.back();
+
+	if (data.empty()) {
+		return;
+	}
+
+	if (papki::is_dir(e.name)) {
+		throw std::logic_error("zip_writer::write(): directory entry cannot have data");
+	}
+
+	e.crc = update_crc32(e.crc, data);
+	e.uncompressed_size += data.size();
+
+	if (e.compression_method == compression_method_deflate) {
+		this->write_compressed(data, false);
+	} else {
+		this->write_to_sink(data);
+		e.compressed_size += data.size();
+	}
+}
+
+void zip_writer::end_entry()
+{
+	if (!this->is_entry_open) {
+		return;
+	}
+
+	this->is_entry_open = false;
+
+	ASSERT(!this->entries.empty())
+	const auto& e = this->entries.back();
+
+	if (e.compression_method == compression_method_deflate) {
+		this->write_compressed(utki::span<const uint8_t>(), true);
+	}
+
+	if ((e.flags & flag_data_descriptor) == 0) {
+		return;
+	}
+
+	std::vector<uint8_t> descriptor;
+	descriptor.reserve(16);
+	put_32(descriptor, data_descriptor_signature);
+	put_32(descriptor, e.crc);
+	put_32(descriptor, check_size(e.compressed_size));
+	put_32(descriptor, check_size(e.uncompressed_size));
+
+	this->write_to_sink(descriptor);
+}
+
+void zip_writer::add_entry(std::string_view name, utki::span<const uint8_t> data, method compression)
+{
+	if (compression == method::store && !papki::is_dir(name)) {
+		// CRC and size of the data are known up front, so these are written to the local header
+		// and the entry does not need the data descriptor
+		this->start_entry(name, compression, data);
+		this->write_to_sink(data);
+		this->end_entry();
+		return;
+	}
+
+	this->begin_entry(name, compression);
+	this->write(data);
+	this->end_entry();
+}
+
+std::unique_ptr<papki::file> zip_writer::finish()
+{
+	if (!this->sink) {
+		throw std::logic_error("zip_writer::finish(): archive is already finished");
+	}
+
+	this->end_entry();
+
+	uint64_t central_dir_offset = this->offset;
+
+	std::vector<uint8_t> header;
+	for (const auto& e : this->entries) {
+		header.clear();
+		put_32(header, central_header_signature);
+		put_16(header, version_needed); // version made by, MS-DOS
+		put_16(header, version_needed);
+		put_16(header, e.flags);
+		put_16(header, e.compression_method);
+		put_16(header, dos_time);
+		put_16(header, dos_date);
+		put_32(header, e.crc);
+		put_32(header, check_size(e.compressed_size));
+		put_32(header, check_size(e.uncompressed_size));
+		put_16(header, uint16_t(e.name.size()));
+		put_16(header, 0); // extra field length
+		put_16(header, 0); // comment length
+		put_16(header, 0); // disk number
+		put_16(header, 0); // internal attributes
+		put_32(header, papki::is_dir(e.name) ? external_attributes_dir : 0);
+		put_32(header, check_size(e.local_header_offset));
+		put_string(header, e.name);
+
+		this->write_to_sink(header);
+	}
+
+	uint64_t central_dir_size = this->offset - central_dir_offset;
+
+	header.clear();
+	put_32(header, end_of_central_dir_signature);
+	put_16(header, 0); // number of this disk
+	put_16(header, 0); // disk where central directory starts
+	put_16(header, uint16_t(this->entries.size())); // number of central directory records on this disk
+	put_16(header, uint16_t(this->entries.size())); // total number of central directory records
+	put_32(header, check_size(central_dir_size));
+	put_32(header, check_size(central_dir_offset));
+	put_16(header, 0); // comment length
+
+	this->write_to_sink(header);
+
+	this->sink->close();
+
+	this->entries.clear();
+
+	return std::move(this->sink);
+}
@@ -0,0 +1,181 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2015-2025 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+/* ================ LICENSE END ================ */
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <utki/span.hpp>
+
+#include "file.hpp"
+
+namespace papki {
+
+/**
+ * @brief Zip archive writer.
+ * Creates zip archive by writing it sequentially to a file object, the sink.
+ * The entries are written one by one, each entry's data is streamed to the sink
+ * while it is being written, so the entries do not have to be held in memory.
+ * CRC and sizes of the entry are calculated while the entry data is written and are
+ * stored in a data descriptor after the entry data, so the sink does not need to support seeking.
+ * Stored entries added with add_entry() have CRC and sizes in the local header instead,
+ * since their data is known up front. Streamed stored entries, i.e. the ones written with
+ * begin_entry() and write(), have the data descriptor, so these can only be read via the central
+ * directory. Readers which rely on the local headers, like java.util.zip.ZipInputStream, reject such entries.
+ * The central directory is written when the archive is finished.
+ * All entries get the same fixed modification time of 1980-01-01 00:00:00, so that
+ * archiving the same data always produces the same archive.
+ * ZIP64 extensions are not supported, so the archive is limited to 65534 entries
+ * and 4 gigabytes in size.
+ */
+class zip_writer
+{
+public:
+	/**
+	 * @brief Compression method of an entry.
+	 */
+	enum class method {
+		store,
+		deflate
+	};
+
+private:
+	std::unique_ptr<papki::file> sink;
+
+	// number of bytes written to the sink
+	uint64_t offset = 0;
+
+	struct entry_record {
+		std::string name;
+		uint16_t flags;
+		uint16_t compression_method;
+		uint32_t crc;
+		uint64_t compressed_size;
+		uint64_t uncompressed_size;
+		uint64_t local_header_offset;
+	};
+
+	// written entries, for the central directory
+	std::vector<entry_record> entries;
+
+	bool is_entry_open = false;
+
+	const unsigned deflate_level;
+
+	// Compression state of the currently written deflated entry. It is created on first
+	// deflated entry and reused for the subsequent ones.
+	struct deflate_state;
+	std::unique_ptr<deflate_state> deflater;
+
+	void write_to_sink(utki::span<const uint8_t> data);
+
+	void write_compressed(utki::span<const uint8_t> data, bool finish);
+
+	// In case stored_data is given, the entry is stored and its CRC and size are written
+	// to the local header instead of the data descriptor.
+	void start_entry(
+		std::string_view name,
+		method compression,
+		std::optional<utki::span<const uint8_t>> stored_data
+	);
+
+public:
+	/**
+	 * @brief Constructor.
+	 * Opens the sink file object in papki::mode::create mode.
+	 * @param sink - file object to write the archive to. The path of the file object has to be set.
+	 * @param deflate_level - compression level of the deflated entries, from 0 to 9.
+	 *                        0 means no compression, 9 means best compression.
+	 * @throw std::logic_error - if deflate_level is greater than 9.
+	 */
+	zip_writer(std::unique_ptr<papki::file> sink, unsigned deflate_level = 6);
+
+	zip_writer(const zip_writer&) = delete;
+	zip_writer& operator=(const zip_writer&) = delete;
+
+	zip_writer(zip_writer&&) = delete;
+	zip_writer& operator=(zip_writer&&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * In case the archive was not finished, finishes it and ignores any errors.
+	 * Call finish() explicitly in order to get the errors reported.
+	 */
+	~zip_writer() noexcept;
+
+	/**
+	 * @brief Start new entry.
+	 * In case there is an entry being written, it is ended first.
+	 * After starting an entry its data is written with write().
+	 * @param name - path of the entry within the archive. The path must not start with '/'.
+	 *               In case the path ends with '/', the entry is a directory entry, which cannot have any data.
+	 * @param compression - compression method of the entry. Directory entries are always stored.
+	 * @throw std::logic_error - if the archive is finished or in case of invalid entry name.
+	 * @throw std::runtime_error - if the archive becomes too big for the zip format.
+	 */
+	void begin_entry(std::string_view name, method compression = method::deflate);
+
+	/**
+	 * @brief Write data of the current entry.
+	 * @param data - data to append to the current entry.
+	 * @throw std::logic_error - if there is no current entry or the current entry is a directory.
+	 */
+	void write(utki::span<const uint8_t> data);
+
+	/**
+	 * @brief End current entry.
+	 * Flushes the compressed data of the entry and writes the data descriptor.
+	 * Does nothing if there is no current entry.
+	 */
+	void end_entry();
+
+	/**
+	 * @brief Add whole entry.
+	 * Same as begin_entry(), write() and end_entry(), except that stored entry
+	 * is written without the data descriptor.
+	 * @param name - path of the entry within the archive.
+	 * @param data - data of the entry.
+	 * @param compression - compression method of the entry.
+	 */
+	void add_entry(std::string_view name, utki::span<const uint8_t> data, method compression = method::deflate);
+
+	/**
+	 * @brief Finish the archive.
+	 * Ends current entry, writes the central directory and closes the sink.
+	 * No entries can be added after that.
+	 * @return The sink file object.
+	 * @throw std::logic_error - if the archive is already finished.
+	 * @throw std::runtime_error - if the archive is too big for the zip format.
+	 */
+	std::unique_ptr<papki::file> finish();
+};
+
+} // namespace papki
@@ -0,0 +1,161 @@
+#include <utki/debug.hpp>
+
+#include "../../src/papki/buffered_file.hpp"
+#include "../../src/papki/span_file.hpp"
+#include "../../src/papki/vector_file.hpp"
+
+#ifdef assert
+#	undef assert
+#endif
+
+// NOLINTNEXTLINE(bugprone-exception-escape, "we want uncaught exceptions to fail the tests")
+int main(int /* argc */, const char** /* argv */){
+	std::vector<uint8_t> data(1000);
+	for(size_t i = 0; i != data.size(); ++i){
+		data[i] = uint8_t(i);
+	}
+
+	// test reading with small chunks
+	{
+		papki::buffered_file f(std::make_unique<papki::span_file>(utki::make_span(data)), 64);
+
+		papki::file::guard file_guard(f);
+
+		std::vector<uint8_t> res;
+		std::array<uint8_t, 7> buf{};
+		for(;;){
+			auto n = f.read(utki::make_span(buf));
+			res.insert(res.end(), buf.begin(), std::next(buf.begin(), std::ptrdiff_t(n)));
+			utki::assert(f.cur_pos() == res.size(), SL);
+			if(n != buf.size()){
+				break;
+			}
+		}
+
+		utki::assert(utki::deep_equals(utki::make_span(res), utki::make_span(data)), SL);
+	}
+
+	// test loading
+	{
+		papki::buffered_file f(std::make_unique<papki::span_file>(utki::make_span(data)), 64);
+
+		auto res = f.load();
+
+		utki::assert(utki::deep_equals(utki::make_span(res), utki::make_span(data)), SL);
+	}
+
+	// test seeking
+	{
+		papki::buffered_file f(std::make_unique<papki::span_file>(utki::make_span(data)), 64);
+
+		papki::file::guard file_guard(f);
+
+		std::array<uint8_t, 3> buf{};
+
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == 0, SL);
+
+		// seek within buffer
+		utki::assert(f.seek_forward(10) == 10, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == 13, SL);
+
+		utki::assert(f.seek_backward(5) == 5, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == 11, SL);
+
+		// seek beyond buffer
+		utki::assert(f.seek_forward(500) == 500, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == uint8_t(514), SL);
+
+		utki::assert(f.seek_backward(300) == 300, SL);
+		utki::assert(f.cur_pos() == 217, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == uint8_t(217), SL);
+
+		// seek beyond end of file
+		utki::assert(f.seek_forward(data.size()) == data.size() - 220, SL);
+		utki::assert(f.read(utki::make_span(buf)) == 0, SL);
+
+		f.rewind();
+		utki::assert(f.cur_pos() == 0, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == 0, SL);
+
+		// absolute seek within buffer
+		utki::assert(f.seek(40) == 40, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == 40, SL);
+
+		utki::assert(f.seek(1) == 1, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == 1, SL);
+
+		// absolute seek beyond buffer
+		utki::assert(f.seek(700) == 700, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == uint8_t(700), SL);
+
+		utki::assert(f.seek(100) == 100, SL);
+		utki::assert(f.cur_pos() == 100, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == 100, SL);
+
+		// absolute seek beyond end of file
+		utki::assert(f.seek(data.size() + 10) == data.size(), SL);
+		utki::assert(f.read(utki::make_span(buf)) == 0, SL);
+	}
+
+	// test writing
+	{
+		papki::buffered_file f(std::make_unique<papki::vector_file>(), 64);
+
+		{
+			papki::file::guard file_guard(f, papki::mode::create);
+
+			for(size_t i = 0; i < data.size(); i += 10){
+				utki::assert(f.write(utki::make_span(&data[i], 10)) == 10, SL);
+			}
+
+			// big write goes directly to the underlying file
+			utki::assert(f.write(utki::make_span(data)) == data.size(), SL);
+
+			utki::assert(f.cur_pos() == 2 * data.size(), SL);
+		}
+
+		auto res = f.load();
+
+		utki::assert(res.size() == 2 * data.size(), SL);
+		utki::assert(utki::deep_equals(utki::make_span(res.data(), data.size()), utki::make_span(data)), SL);
+		utki::assert(utki::deep_equals(utki::make_span(res.data() + data.size(), data.size()), utki::make_span(data)), SL);
+	}
+
+	// test reading after writing and writing after reading
+	{
+		papki::buffered_file f(std::make_unique<papki::vector_file>(), 64);
+
+		papki::file::guard file_guard(f, papki::mode::create);
+
+		utki::assert(f.write(utki::make_span(data.data(), 100)) == 100, SL);
+
+		f.rewind();
+
+		std::array<uint8_t, 10> buf{};
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[9] == 9, SL);
+
+		// overwrite bytes 10-12
+		std::array<uint8_t, 3> patch = {0xff, 0xfe, 0xfd};
+		utki::assert(f.write(utki::make_span(patch)) == patch.size(), SL);
+
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == 13, SL);
+
+		std::array<uint8_t, 4> at{};
+		utki::assert(f.read_at(9, utki::make_span(at)) == at.size(), SL);
+		utki::assert(at[0] == 9 && at[1] == 0xff && at[2] == 0xfe && at[3] == 0xfd, SL);
+	}
+
+	return 0;
+}
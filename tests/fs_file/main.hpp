@@ -6,7 +6,12 @@
 
 inline void test_papki_fs_file(){
 	test_seek_forward::run();
+	test_read_at::run();
+	test_read_at_async::run();
+	test_fd_access::run();
+	test_access_hints::run();
 	test_list_dir_contents::run();
+	test_walk::run();
 	test_home_dir::run();
 	test_load_whole_file_to_memory::run();
 }
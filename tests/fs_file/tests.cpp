@@ -1,9 +1,14 @@
+#include <algorithm>
+#include <filesystem>
+#include <mutex>
+
 #include <utki/debug.hpp>
 #include <utki/types.hpp>
 
 #include "../../src/papki/fs_file.hpp"
 #include "../../src/papki/root_dir.hpp"
 #include "../../src/papki/util.hpp"
+#include "../../src/papki/walk.hpp"
 
 #include "tests.hpp"
 
@@ -57,6 +62,321 @@ void run(){
 			utki::assert(buf[0] == test_byte[0], SL);
 		}
 	}
+
+	// absolute seeking, forward and backward
+	{
+		auto contents = f.load();
+
+		for(auto file_access : {papki::fs_file::access::stdio, papki::fs_file::access::fd}){
+			papki::fs_file file(f.path(), file_access);
+			papki::file::guard file_guard(file, papki::mode::read);
+
+			for(uint64_t pos : {uint64_t(1000), uint64_t(10), uint64_t(60000), uint64_t(0), uint64_t(contents.size())}){
+				utki::assert(file.seek(pos) == pos, SL);
+				utki::assert(file.cur_pos() == pos, SL);
+
+				std::array<uint8_t, 1> buf{};
+				if(pos == contents.size()){
+					utki::assert(file.read(utki::make_span(buf)) == 0, SL);
+				}else{
+					utki::assert(file.read(utki::make_span(buf)) == 1, SL);
+					utki::assert(buf[0] == contents[size_t(pos)], SL);
+				}
+			}
+
+			utki::assert(file.seek(contents.size() + 1) == contents.size(), SL);
+		}
+	}
+
+	// seeking beyond end of file
+	{
+		const size_t file_size = 66874;
+
+		papki::file::guard file_guard(f, papki::mode::read);
+
+		utki::assert(f.seek_forward(file_size - 1) == file_size - 1, SL);
+		utki::assert(f.cur_pos() == file_size - 1, SL);
+
+		auto res = f.seek_forward(0x1000);
+		utki::assert(res == 1, [&](auto&o){o << "res = " << res;}, SL);
+		utki::assert(f.cur_pos() == file_size, SL);
+
+		std::array<uint8_t, 1> buf{};
+		utki::assert(f.read(utki::make_span(buf)) == 0, SL);
+
+		utki::assert(f.seek_backward(1) == 1, SL);
+		utki::assert(f.read(utki::make_span(buf)) == 1, SL);
+		utki::assert(f.seek_forward(1) == 0, SL);
+	}
+
+#if CFG_OS == CFG_OS_LINUX
+	// files in /proc are not regular files, they report zero size, but have contents
+	for(auto file_access : {papki::fs_file::access::stdio, papki::fs_file::access::fd}){
+		papki::fs_file file("/proc/self/status", file_access);
+
+		auto contents = file.load();
+		utki::assert(contents.size() > 20, SL);
+
+		papki::file::guard file_guard(file, papki::mode::read);
+		utki::assert(!file.size_hint().has_value(), SL);
+
+		std::array<uint8_t, 5> buf{};
+		utki::assert(file.seek_forward(5) == 5, SL);
+		utki::assert(file.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(std::equal(buf.begin(), buf.end(), std::next(contents.begin(), 5)), SL);
+
+		utki::assert(file.seek_forward(5) == 5, SL);
+		utki::assert(file.cur_pos() == 15, SL);
+
+		utki::assert(file.seek(2) == 2, SL);
+		utki::assert(file.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(std::equal(buf.begin(), buf.end(), std::next(contents.begin(), 2)), SL);
+	}
+#endif
+}
+}
+
+
+
+namespace test_read_at{
+void run(){
+	papki::fs_file f("test.file.txt");
+
+	auto expected = f.load();
+	utki::assert(expected.size() == 66874, SL);
+
+	papki::file::guard file_guard(f, papki::mode::read);
+
+	std::array<uint8_t, 3> first{};
+	utki::assert(f.read(utki::make_span(first)) == first.size(), SL);
+
+	for(size_t offset : {size_t(0), size_t(1), size_t(4095), size_t(4096), size_t(40000), expected.size() - 2, expected.size()}){
+		std::array<uint8_t, 0x1000> buf{};
+
+		auto res = f.read_at(offset, utki::make_span(buf));
+		utki::assert(res == std::min(buf.size(), expected.size() - offset), [&](auto&o){o << "res = " << res;}, SL);
+		utki::assert(
+			utki::deep_equals(
+				utki::make_span(buf.data(), res),
+				utki::make_span(expected.data() + offset, res)
+			),
+			SL
+		);
+	}
+
+	// current position is not affected by read_at()
+	utki::assert(f.cur_pos() == first.size(), SL);
+
+	std::array<uint8_t, 1> next{};
+	utki::assert(f.read(utki::make_span(next)) == next.size(), SL);
+	utki::assert(next[0] == expected[first.size()], SL);
+}
+}
+
+
+
+namespace test_read_at_async{
+void run(){
+	papki::fs_file f("test.file.txt");
+
+	auto expected = f.load();
+	utki::assert(expected.size() == 66874, SL);
+
+	// reading closed file is not allowed
+	{
+		std::array<uint8_t, 1> buf{};
+		bool thrown = false;
+		try{
+			f.read_at_async(0, utki::make_span(buf));
+		}catch(std::logic_error&){
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+	}
+
+	for(auto access : {papki::fs_file::access::stdio, papki::fs_file::access::fd}){
+		papki::root_dir rf(std::make_unique<papki::fs_file>(std::string_view(), access), "");
+		rf.set_path("test.file.txt");
+
+		papki::file::guard file_guard(rf, papki::mode::read);
+
+		// many reads in flight
+		const size_t chunk_size = 61;
+		const size_t num_chunks = expected.size() / chunk_size + 1;
+
+		std::vector<uint8_t> data(num_chunks * chunk_size);
+		std::vector<std::future<size_t>> futures;
+		futures.reserve(num_chunks);
+
+		// issue reads in reverse order
+		for(size_t i = num_chunks; i != 0; --i){
+			size_t offset = (i - 1) * chunk_size;
+			futures.push_back(rf.read_at_async(offset, utki::make_span(data.data() + offset, chunk_size)));
+		}
+
+		size_t num_bytes_read = 0;
+		for(auto& future : futures){
+			num_bytes_read += future.get();
+		}
+		utki::assert(num_bytes_read == expected.size(), [&](auto&o){o << "num_bytes_read = " << num_bytes_read;}, SL);
+
+		data.resize(num_bytes_read);
+		utki::assert(data == expected, SL);
+
+		// read beyond end of file
+		std::array<uint8_t, 0x100> buf{};
+		utki::assert(rf.read_at_async(expected.size() - 10, utki::make_span(buf)).get() == 10, SL);
+		utki::assert(rf.read_at_async(expected.size() + 10, utki::make_span(buf)).get() == 0, SL);
+
+		// current position is not affected
+		utki::assert(rf.cur_pos() == 0, SL);
+	}
+
+	// data written in write mode is visible to asynchronous reads
+	{
+		const std::string file_name = "read_at_async_test.tmp";
+
+		papki::fs_file wf(file_name);
+		{
+			papki::file::guard file_guard(wf, papki::mode::create);
+			wf.write(utki::make_span(expected));
+		}
+
+		{
+			papki::file::guard file_guard(wf, papki::mode::write);
+			const std::array<uint8_t, 3> data = {'a', 'b', 'c'};
+			wf.write(utki::make_span(data));
+
+			std::array<uint8_t, 4> buf{};
+			utki::assert(wf.read_at_async(1, utki::make_span(buf)).get() == buf.size(), SL);
+			utki::assert(buf[0] == 'b' && buf[1] == 'c' && buf[2] == expected[3], SL);
+		}
+
+		utki::assert(std::remove(file_name.c_str()) == 0, SL);
+	}
+}
+}
+
+
+
+namespace test_fd_access{
+void run(){
+	auto expected = papki::fs_file("test.file.txt").load();
+	utki::assert(expected.size() == 66874, SL);
+
+	papki::fs_file f("test.file.txt", papki::fs_file::access::fd);
+
+	// whole file
+	{
+		auto contents = f.load();
+		utki::assert(contents == expected, SL);
+	}
+
+	// sequential reads and seeks
+	{
+		papki::file::guard file_guard(f, papki::mode::read);
+
+		std::array<uint8_t, 100> buf{};
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(utki::deep_equals(utki::make_span(buf), utki::make_span(expected.data(), buf.size())), SL);
+
+		utki::assert(f.seek_forward(40000) == 40000, SL);
+		utki::assert(f.seek_backward(20000) == 20000, SL);
+		utki::assert(f.cur_pos() == 20100, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(utki::deep_equals(utki::make_span(buf), utki::make_span(expected.data() + 20100, buf.size())), SL);
+
+		std::array<uint8_t, 10> at_buf{};
+		utki::assert(f.read_at(expected.size() - 5, utki::make_span(at_buf)) == 5, SL);
+		utki::assert(utki::deep_equals(utki::make_span(at_buf.data(), 5), utki::make_span(expected.data() + expected.size() - 5, 5)), SL);
+		utki::assert(f.cur_pos() == 20200, SL);
+
+		// seeking beyond end of file
+		utki::assert(f.seek_forward(expected.size()) == expected.size() - 20200, SL);
+		utki::assert(f.read(utki::make_span(buf)) == 0, SL);
+
+		f.rewind();
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(utki::deep_equals(utki::make_span(buf), utki::make_span(expected.data(), buf.size())), SL);
+	}
+
+	// spawned file uses same access method
+	{
+		auto spawned = f.file::spawn("test.file.txt");
+		utki::assert(spawned->load() == expected, SL);
+	}
+
+	// writing
+	{
+		const std::string file_name = "fd_access_test.tmp";
+
+		papki::fs_file wf(file_name, papki::fs_file::access::fd);
+		{
+			papki::file::guard file_guard(wf, papki::mode::create);
+			wf.write(utki::make_span(expected));
+			utki::assert(wf.size() == expected.size(), SL);
+		}
+
+		utki::assert(papki::fs_file(file_name).load() == expected, SL);
+
+		{
+			papki::file::guard file_guard(wf, papki::mode::write);
+			wf.seek_forward(10);
+			const std::array<uint8_t, 3> data = {'a', 'b', 'c'};
+			wf.write(utki::make_span(data));
+
+			std::array<uint8_t, 5> buf{};
+			utki::assert(wf.read_at(9, utki::make_span(buf)) == buf.size(), SL);
+			utki::assert(buf[0] == expected[9], SL);
+			utki::assert(buf[1] == 'a' && buf[2] == 'b' && buf[3] == 'c', SL);
+			utki::assert(buf[4] == expected[13], SL);
+		}
+
+		utki::assert(std::remove(file_name.c_str()) == 0, SL);
+	}
+}
+}
+
+
+
+namespace test_access_hints{
+void run(){
+	for(auto access : {papki::fs_file::access::stdio, papki::fs_file::access::fd}){
+		papki::fs_file f("test.file.txt", access);
+
+		// hints cannot be given for a closed file
+		{
+			bool thrown = false;
+			try{
+				f.advise(papki::access_hint::sequential);
+			}catch(std::logic_error&){
+				thrown = true;
+			}
+			utki::assert(thrown, SL);
+		}
+
+		auto expected = f.load();
+
+		papki::file::guard file_guard(f, papki::mode::read);
+
+		f.advise(papki::access_hint::sequential);
+		f.prefetch(0, 0x1000);
+
+		std::array<uint8_t, 0x100> buf{};
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+
+		f.advise(papki::access_hint::random, 0x1000);
+		f.advise(papki::access_hint::will_need, 40000, 0x1000);
+		f.advise(papki::access_hint::dont_need, 0, 0x100);
+		f.prefetch(40000, 0x1000);
+
+		// hints do not change file position or contents
+		utki::assert(f.cur_pos() == buf.size(), SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(utki::deep_equals(utki::make_span(buf), utki::make_span(expected.data() + buf.size(), buf.size())), SL);
+
+		f.advise(papki::access_hint::normal);
+	}
 }
 }
 
@@ -83,6 +403,213 @@ void run(){
 	utki::assert(r2.size() == 2, SL);
 	utki::assert(r[0] == r2[0], SL);
 	utki::assert(r[1] == r2[1], SL);
+
+	// compact listing gives same entries
+	{
+		auto l = f.list_dir_compact();
+		utki::assert(l.size() == r.size(), SL);
+		for(size_t i = 0; i != l.size(); ++i){
+			utki::assert(l[i] == r[i], [&](auto&o){o << "l[" << i << "] = " << l[i];}, SL);
+		}
+		utki::assert(l.to_vector() == r, SL);
+
+		auto l1 = f.list_dir_compact(1);
+		utki::assert(l1.size() == 1, SL);
+		utki::assert(l1[0] == r[0], SL);
+
+		// 0 means no limit
+		utki::assert(f.list_dir_compact(0).to_vector() == r, SL);
+		utki::assert(f.list_dir(0) == r, SL);
+	}
+
+	// directories have trailing slash, symbolic links are followed
+	{
+		const std::string dir = "list_dir_test/";
+		std::filesystem::remove_all(dir);
+		std::filesystem::create_directories(dir + "subdir");
+		{
+			papki::fs_file file(dir + "file.txt");
+			papki::file::guard file_guard(file, papki::mode::create);
+			file.write(std::string("a"));
+		}
+#if CFG_OS != CFG_OS_WINDOWS
+		std::filesystem::create_directory_symlink("subdir", dir + "link_to_subdir");
+		std::filesystem::create_symlink("file.txt", dir + "link_to_file");
+		std::filesystem::create_symlink("non_existent", dir + "dangling_link");
+#endif
+
+		auto l = papki::fs_file(dir).list_dir_compact();
+		std::vector<std::string> entries(l.begin(), l.end());
+		std::sort(entries.begin(), entries.end());
+
+		// lazy directory entries give the same names
+		{
+			std::vector<std::string> lazy_entries;
+			for(const auto& e : papki::fs_file(dir).dir_entries()){
+				utki::assert(e.is_dir == papki::is_dir(e.name), SL);
+				lazy_entries.emplace_back(e.name);
+			}
+			std::sort(lazy_entries.begin(), lazy_entries.end());
+			utki::assert(lazy_entries == entries, SL);
+		}
+
+		std::vector<std::string> expected = {
+#if CFG_OS != CFG_OS_WINDOWS
+			"dangling_link",
+#endif
+			"file.txt",
+#if CFG_OS != CFG_OS_WINDOWS
+			"link_to_file",
+			"link_to_subdir/",
+#endif
+			"subdir/"
+		};
+		utki::assert(entries == expected, [&](auto&o){
+			for(const auto& e : entries){
+				o << e << ' ';
+			}
+		}, SL);
+
+		std::filesystem::remove_all(dir);
+	}
+}
+}
+
+
+
+namespace test_walk{
+void run(){
+	const std::string dir = "walk_test/";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir + "a/b/c");
+	std::filesystem::create_directories(dir + "d");
+	for(const auto& name : {"1.txt", "a/2.txt", "a/b/3.txt", "a/b/c/4.txt", "d/5.txt"}){
+		papki::fs_file file(dir + name);
+		papki::file::guard file_guard(file, papki::mode::create);
+		file.write(std::string("abc"));
+	}
+
+	auto walk = [&](const papki::walk_parameters& params){
+		std::mutex mutex;
+		std::vector<std::string> paths;
+		papki::walk(papki::fs_file(dir), [&](const papki::walk_entry& e){
+			utki::assert(e.path.compare(0, dir.size(), dir) == 0, SL);
+			utki::assert(e.is_dir == papki::is_dir(e.path), SL);
+			std::lock_guard<std::mutex> lock(mutex);
+			paths.push_back(e.path.substr(dir.size()));
+		}, params);
+		std::sort(paths.begin(), paths.end());
+		return paths;
+	};
+
+	// whole tree
+	for(unsigned num_threads : {1, 4}){
+		papki::walk_parameters params;
+		params.num_threads = num_threads;
+		auto paths = walk(params);
+		std::vector<std::string> expected = {
+			"1.txt", "a/", "a/2.txt", "a/b/", "a/b/3.txt", "a/b/c/", "a/b/c/4.txt", "d/", "d/5.txt"
+		};
+		utki::assert(paths == expected, [&](auto&o){
+			for(const auto& p : paths){
+				o << p << ' ';
+			}
+		}, SL);
+	}
+
+	// max depth
+	{
+		papki::walk_parameters params;
+		params.max_depth = 1;
+		auto paths = walk(params);
+		std::vector<std::string> expected = {"1.txt", "a/", "a/2.txt", "a/b/", "d/", "d/5.txt"};
+		utki::assert(paths == expected, SL);
+	}
+
+	// prune
+	{
+		papki::walk_parameters params;
+		params.prune = [&](const papki::walk_entry& e){
+			return papki::not_dir(papki::as_file(e.path)) == "a";
+		};
+		auto paths = walk(params);
+		std::vector<std::string> expected = {"1.txt", "a/", "d/", "d/5.txt"};
+		utki::assert(paths == expected, SL);
+	}
+
+#if CFG_OS != CFG_OS_WINDOWS
+	// symbolic links to directories, including a loop
+	{
+		const std::string other_dir = "walk_test_other/";
+		std::filesystem::remove_all(other_dir);
+		std::filesystem::create_directories(other_dir);
+		{
+			papki::fs_file file(other_dir + "6.txt");
+			papki::file::guard file_guard(file, papki::mode::create);
+			file.write(std::string("abc"));
+		}
+
+		std::filesystem::create_directory_symlink("..", dir + "a/up");
+		std::filesystem::create_directory_symlink("../..", dir + "a/b/up");
+		std::filesystem::create_directory_symlink("../../" + other_dir, dir + "d/other");
+
+		std::vector<std::string> expected = {
+			"1.txt", "a/", "a/2.txt", "a/b/", "a/b/3.txt", "a/b/c/", "a/b/c/4.txt", "a/b/up/", "a/up/", "d/", "d/5.txt", "d/other/"
+		};
+
+		for(unsigned num_threads : {1, 4}){
+			papki::walk_parameters params;
+			params.num_threads = num_threads;
+
+			// by default the links are reported, but not followed
+			std::mutex mutex;
+			std::vector<std::string> symlinks;
+			papki::walk(papki::fs_file(dir), [&](const papki::walk_entry& e){
+				if(e.is_symlink){
+					std::lock_guard<std::mutex> lock(mutex);
+					symlinks.push_back(e.path.substr(dir.size()));
+				}
+			}, params);
+			std::sort(symlinks.begin(), symlinks.end());
+			utki::assert(symlinks == std::vector<std::string>{"a/b/up/", "a/up/", "d/other/"}, SL);
+
+			utki::assert(walk(params) == expected, SL);
+
+			// the links are followed, but the directories reached via the loops are not walked again
+			params.follow_symlinks = true;
+			auto paths = walk(params);
+			auto expected_followed = expected;
+			expected_followed.push_back("d/other/6.txt");
+			std::sort(expected_followed.begin(), expected_followed.end());
+			utki::assert(paths == expected_followed, [&](auto&o){
+				for(const auto& p : paths){
+					o << p << ' ';
+				}
+			}, SL);
+		}
+
+		std::filesystem::remove(dir + "a/up");
+		std::filesystem::remove(dir + "a/b/up");
+		std::filesystem::remove(dir + "d/other");
+		std::filesystem::remove_all(other_dir);
+	}
+#endif
+
+	// exception from callback stops the walk and is rethrown
+	{
+		bool thrown = false;
+		try{
+			papki::walk(papki::fs_file(dir), [](const papki::walk_entry&){
+				throw std::runtime_error("stop");
+			});
+		}catch(std::runtime_error& e){
+			thrown = true;
+			utki::assert(std::string(e.what()) == "stop", SL);
+		}
+		utki::assert(thrown, SL);
+	}
+
+	std::filesystem::remove_all(dir);
 }
 }
 
@@ -5,10 +5,30 @@ namespace test_seek_forward{
 void run();
 }
 
+namespace test_read_at{
+void run();
+}
+
+namespace test_read_at_async{
+void run();
+}
+
+namespace test_fd_access{
+void run();
+}
+
+namespace test_access_hints{
+void run();
+}
+
 namespace test_list_dir_contents{
 void run();
 }
 
+namespace test_walk{
+void run();
+}
+
 namespace test_home_dir{
 void run();
 }
@@ -0,0 +1,123 @@
+#include <utki/debug.hpp>
+
+#include "../../src/papki/fs_file.hpp"
+#include "../../src/papki/mmap_file.hpp"
+
+#ifdef assert
+#	undef assert
+#endif
+
+// NOLINTNEXTLINE(bugprone-exception-escape, "we want uncaught exceptions to fail the tests")
+int main(int /* argc */, const char** /* argv */){
+	const auto expected = papki::fs_file("test_data.bin").load();
+	utki::assert(expected.size() == 49179, SL);
+
+	// test loading whole file
+	{
+		papki::mmap_file f("test_data.bin");
+
+		utki::assert(f.size() == expected.size(), SL);
+
+		auto bytes = f.load();
+
+		utki::assert(utki::deep_equals(utki::make_span(bytes), utki::make_span(expected)), SL);
+	}
+
+	// test zero-copy access to file contents
+	{
+		papki::mmap_file f("test_data.bin");
+
+		papki::file::guard file_guard(f);
+
+		auto data = f.data();
+
+		utki::assert(data.size() == expected.size(), SL);
+		utki::assert(utki::deep_equals(data, utki::make_span(expected)), SL);
+	}
+
+	// test seeking and reading
+	{
+		papki::mmap_file f("test_data.bin");
+
+		papki::file::guard file_guard(f);
+
+		std::array<uint8_t, 3> buf{};
+
+		utki::assert(f.seek_forward(1000) == 1000, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == expected[1000] && buf[1] == expected[1001] && buf[2] == expected[1002], SL);
+		utki::assert(f.cur_pos() == 1003, SL);
+
+		utki::assert(f.seek_backward(500) == 500, SL);
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == expected[503], SL);
+
+		// seeking beyond end of file stops at the end of file
+		utki::assert(f.seek_forward(expected.size()) == expected.size() - 506, SL);
+		utki::assert(f.read(utki::make_span(buf)) == 0, SL);
+
+		f.rewind();
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == expected[0], SL);
+	}
+
+	// test access hints
+	{
+		papki::mmap_file f("test_data.bin");
+
+		papki::file::guard file_guard(f);
+
+		f.advise(papki::access_hint::sequential);
+		f.advise(papki::access_hint::random, 5000, 100);
+		f.advise(papki::access_hint::will_need, 40000);
+		f.prefetch(expected.size() - 10, 1000);
+		f.advise(papki::access_hint::dont_need, expected.size() + 1);
+
+		std::array<uint8_t, 3> buf{};
+		utki::assert(f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(buf[0] == expected[0] && buf[1] == expected[1] && buf[2] == expected[2], SL);
+	}
+
+	// test empty file
+	{
+		papki::mmap_file f("empty.bin");
+
+		utki::assert(f.load().empty(), SL);
+
+		papki::file::guard file_guard(f);
+		utki::assert(f.data().empty(), SL);
+	}
+
+#if CFG_OS == CFG_OS_LINUX
+	// test that files which cannot be mapped are not read as empty
+	for (const auto path : {"/proc/self/status", "/dev/null"}) {
+		papki::mmap_file f(path);
+
+		bool thrown = false;
+		try {
+			f.load();
+		} catch (std::runtime_error&) {
+			thrown = true;
+		}
+		utki::assert(thrown, [&](auto& o) {
+			o << "path = " << path;
+		}, SL);
+	}
+#endif
+
+	// test that opening for writing is not allowed
+	{
+		papki::mmap_file f("test_data.bin");
+
+		bool thrown = false;
+		try {
+			f.open(papki::mode::write);
+		} catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+		utki::assert(!f.is_open(), SL);
+	}
+
+	return 0;
+}
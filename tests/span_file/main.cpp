@@ -39,6 +39,70 @@ int main(int /* argc */, const char** /* argv */){
 		}
 	}
 
+	// test loading part of the file
+	{
+		const auto hw = "Hello world!";
+
+		auto span = utki::make_span(hw);
+
+		papki::span_file file(span);
+
+		for(size_t max_size : {size_t(0), size_t(1), span.size() - 1, span.size(), span.size() + 1}){
+			auto res = file.load(max_size);
+
+			utki::assert(res.size() == std::min(max_size, span.size()), SL);
+			utki::assert(
+				utki::deep_equals(
+					span.subspan(0, res.size()),
+					utki::make_span(res)
+				),
+				SL
+			);
+		}
+	}
+
+	// test positional reading
+	{
+		const auto hw = "Hello world!";
+
+		auto span = utki::make_span(hw);
+
+		papki::span_file file(span);
+
+		papki::file::guard file_guard(file);
+
+		std::array<char, 5> buf{};
+
+		auto res = file.read_at(6, utki::to_uint8_t(utki::make_span(buf)));
+		utki::assert(res == buf.size(), SL);
+		utki::assert(utki::deep_equals(utki::make_span(buf), span.subspan(6, 5)), SL);
+
+		res = file.read_at(10, utki::to_uint8_t(utki::make_span(buf)));
+		utki::assert(res == 2, SL);
+
+		res = file.read_at(100, utki::to_uint8_t(utki::make_span(buf)));
+		utki::assert(res == 0, SL);
+
+		utki::assert(file.cur_pos() == 0, SL);
+	}
+
+	// test asynchronous read, span_file reads synchronously
+	{
+		const auto hw = "Hello world!";
+
+		auto span = utki::make_span(hw);
+
+		papki::span_file file(span);
+		papki::file::guard file_guard(file);
+
+		std::array<char, 5> buf{};
+
+		auto future = file.read_at_async(6, utki::to_uint8_t(utki::make_span(buf)));
+		utki::assert(future.wait_for(std::chrono::seconds(0)) == std::future_status::ready, SL);
+		utki::assert(future.get() == buf.size(), SL);
+		utki::assert(utki::deep_equals(utki::make_span(buf), span.subspan(6, 5)), SL);
+	}
+
 	// test span_file spawning
 	{
 		const auto hw = "Hello world!";
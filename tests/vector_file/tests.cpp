@@ -34,5 +34,18 @@ void run(){
 		utki::assert(b[2] == 3, SL);
 		utki::assert(b[3] == 4, SL);
 	}
+
+	{
+		std::array<uint8_t, 4> b{};
+
+		papki::file::guard file_guard(f, papki::mode::read);
+
+		auto res = f.read_at(2, utki::make_span(b));
+
+		utki::assert(res == 2, SL);
+		utki::assert(b[0] == 3, SL);
+		utki::assert(b[1] == 4, SL);
+		utki::assert(f.cur_pos() == 0, SL);
+	}
 }
 }
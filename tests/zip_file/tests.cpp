@@ -1,9 +1,96 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+
 #include <utki/debug.hpp>
 #include "../../src/papki/zip_file.hpp"
 #include "../../src/papki/fs_file.hpp"
+#include "../../src/papki/inflate_engine.hpp"
+#include "../../src/papki/mmap_file.hpp"
+#include "../../src/papki/root_dir.hpp"
+#include "../../src/papki/span_file.hpp"
+#include "../../src/papki/util.hpp"
+#include "../../src/papki/walk.hpp"
+#include "../../src/papki/vector_file.hpp"
+#include "../../src/papki/zip_writer.hpp"
 
 #include "tests.hpp"
 
+namespace{
+// span_file which counts the number of bytes read from it.
+// Relative seeking forward is done by reading, like in file systems which do not support seeking.
+class read_counting_file : public papki::span_file
+{
+	utki::span<const uint8_t> data;
+
+public:
+	std::atomic<size_t>& num_bytes_read;
+
+	read_counting_file(utki::span<const uint8_t> data, std::atomic<size_t>& num_bytes_read) :
+		papki::span_file(data),
+		data(data),
+		num_bytes_read(num_bytes_read)
+	{}
+
+	// spawned files add to the same counter
+	std::unique_ptr<papki::file> spawn() override{
+		return std::make_unique<read_counting_file>(this->data, this->num_bytes_read);
+	}
+
+protected:
+	size_t read_internal(utki::span<uint8_t> buf) const override{
+		auto ret = this->papki::span_file::read_internal(buf);
+		this->num_bytes_read += ret;
+		return ret;
+	}
+
+	size_t read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const override{
+		auto ret = this->papki::span_file::read_at_internal(offset, buf);
+		this->num_bytes_read += ret;
+		return ret;
+	}
+
+	size_t seek_forward_internal(size_t num_bytes_to_seek) const override{
+		return this->papki::file::seek_forward_internal(num_bytes_to_seek);
+	}
+};
+
+// span_file which does not support positional reads
+class no_read_at_file : public papki::span_file
+{
+	utki::span<const uint8_t> data;
+
+public:
+	no_read_at_file(utki::span<const uint8_t> data) :
+		papki::span_file(data),
+		data(data)
+	{}
+
+	std::unique_ptr<papki::file> spawn() override{
+		return std::make_unique<no_read_at_file>(this->data);
+	}
+
+protected:
+	size_t read_at_internal(uint64_t offset, utki::span<uint8_t> buf) const override{
+		return this->papki::file::read_at_internal(offset, buf);
+	}
+};
+
+// inflate engine which counts its uses
+class counting_inflate_engine : public papki::inflate_engine
+{
+public:
+	mutable std::atomic<unsigned> num_calls{0};
+
+	void inflate(utki::span<const uint8_t> compressed, utki::span<uint8_t> uncompressed) const override{
+		++this->num_calls;
+		papki::zlib_inflate_engine::get()->inflate(compressed, uncompressed);
+	}
+};
+}
+
 namespace test_papki_zip_file{
 void run(){
 	// list directory contents
@@ -26,6 +113,11 @@ void run(){
 			utki::assert(contents[2] == "dir2/", SL);
 		}
 
+		// 0 means no limit
+		utki::assert(zip_f.list_dir(0) == zip_f.list_dir(), SL);
+		utki::assert(zip_f.list_dir_compact(0).to_vector() == zip_f.list_dir(), SL);
+		utki::assert(zip_f.list_dir_compact(2).size() == 2, SL);
+
 		zip_f.set_path("dir1/");
 		utki::assert(zip_f.is_dir(), SL);
 		utki::assert(!zip_f.is_open(), SL);
@@ -47,6 +139,51 @@ void run(){
 			
 			utki::assert(contents[0] == "test3.txt", SL);
 		}
+
+		// lazy directory entries
+		zip_f.set_path("./");
+		{
+			std::vector<std::string> names;
+			for(const auto& e : zip_f.dir_entries()){
+				utki::assert(e.is_dir == papki::is_dir(e.name), SL);
+				utki::assert(e.is_dir != e.size.has_value(), SL);
+				names.emplace_back(e.name);
+			}
+			std::sort(names.begin(), names.end());
+			utki::assert(names == std::vector<std::string>{"dir1/", "dir2/", "test1.txt"}, SL);
+		}
+
+		zip_f.set_path("dir1/");
+		{
+			auto entries = zip_f.dir_entries();
+			auto i = entries.begin();
+			utki::assert(i != entries.end(), SL);
+			utki::assert(i->name == "test2.txt", SL);
+			utki::assert(!i->is_dir, SL);
+			utki::assert(i->size.value() == 14, SL);
+			++i;
+			utki::assert(i == entries.end(), SL);
+		}
+	}
+
+	// walk the archive
+	{
+		papki::zip_file zip_f(std::make_unique<papki::fs_file>("test.zip"), "./");
+
+		std::mutex mutex;
+		std::vector<std::string> paths;
+		papki::walk(zip_f, [&](const papki::walk_entry& e){
+			std::lock_guard<std::mutex> lock(mutex);
+			paths.push_back(e.path);
+		});
+		std::sort(paths.begin(), paths.end());
+
+		std::vector<std::string> expected = {"./dir1/", "./dir1/test2.txt", "./dir2/", "./dir2/test3.txt", "./test1.txt"};
+		utki::assert(paths == expected, [&](auto&o){
+			for(const auto& p : paths){
+				o << p << ' ';
+			}
+		}, SL);
 	}
 
 	// reading file
@@ -64,5 +201,604 @@ void run(){
 
 		utki::assert(str == "test file #2.\n", [&](auto&o){o << "str = " << str;}, SL);
 	}
+
+	// check entries existence and open entries in arbitrary order
+	{
+		papki::zip_file zip_f(std::make_unique<papki::fs_file>("test.zip"));
+
+		zip_f.set_path("dir2/test3.txt");
+		utki::assert(zip_f.exists(), SL);
+
+		zip_f.set_path("test1.txt");
+		utki::assert(zip_f.exists(), SL);
+
+		zip_f.set_path("dir1/test3.txt");
+		utki::assert(!zip_f.exists(), SL);
+
+		zip_f.set_path("test2.txt");
+		utki::assert(!zip_f.exists(), SL);
+
+		zip_f.set_path("dir2/test3.txt");
+		{
+			auto contents = zip_f.load();
+			std::string str(contents.begin(), contents.end());
+			utki::assert(str == "test file 3.\n", [&](auto&o){o << "str = " << str;}, SL);
+		}
+
+		zip_f.set_path("test1.txt");
+		{
+			auto contents = zip_f.load();
+			std::string str(contents.begin(), contents.end());
+			utki::assert(str == "test file #1\n", [&](auto&o){o << "str = " << str;}, SL);
+		}
+
+		zip_f.set_path("dir1/test3.txt");
+		bool thrown = false;
+		try {
+			zip_f.open();
+		} catch (std::runtime_error&) {
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+		utki::assert(!zip_f.is_open(), SL);
+	}
+
+	// entry sizes
+	{
+		papki::zip_file zip_f(std::make_unique<papki::fs_file>("test.zip"), "dir1/test2.txt");
+
+		utki::assert(zip_f.size() == 14, [&](auto&o){o << "zip_f.size() = " << zip_f.size();}, SL);
+		utki::assert(zip_f.compressed_size() == 14, [&](auto&o){o << "zip_f.compressed_size() = " << zip_f.compressed_size();}, SL);
+		utki::assert(zip_f.size() == zip_f.load().size(), SL);
+
+		zip_f.set_path("test1.txt");
+		utki::assert(zip_f.size() == 13, [&](auto&o){o << "zip_f.size() = " << zip_f.size();}, SL);
+
+		zip_f.set_path("non_existent.txt");
+		bool thrown = false;
+		try {
+			zip_f.size();
+		} catch (std::runtime_error&) {
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+	}
+
+	// load several entries concurrently
+	{
+		papki::zip_file zip_f(std::make_unique<papki::fs_file>("test.zip"));
+
+		const std::vector<std::string> paths = {
+			"test1.txt",
+			"dir2/test3.txt",
+			"dir1/test2.txt",
+			"test1.txt"
+		};
+
+		const std::vector<std::string> expected = {
+			"test file #1\n",
+			"test file 3.\n",
+			"test file #2.\n",
+			"test file #1\n"
+		};
+
+		for(unsigned num_threads : {0, 1, 2, 8}){
+			auto contents = zip_f.load_entries(utki::make_span(paths), num_threads);
+
+			utki::assert(contents.size() == paths.size(), SL);
+
+			for(size_t i = 0; i != contents.size(); ++i){
+				std::string str(contents[i].begin(), contents[i].end());
+				utki::assert(str == expected[i], [&](auto&o){o << "i = " << i << ", str = " << str;}, SL);
+			}
+		}
+
+		// non-existent entry
+		{
+			const std::vector<std::string> bad_paths = {
+				"test1.txt",
+				"non_existent.txt"
+			};
+
+			bool thrown = false;
+			try {
+				zip_f.load_entries(utki::make_span(bad_paths), 2);
+			} catch (std::runtime_error&) {
+				thrown = true;
+			}
+			utki::assert(thrown, SL);
+		}
+	}
+
+	// stored entries of in-memory zip file are accessed directly
+	{
+		auto zip_data = papki::fs_file("test.zip").load();
+
+		papki::zip_file zip_f(std::make_unique<papki::span_file>(utki::make_span(zip_data)), "dir1/test2.txt");
+
+		papki::file::guard file_guard(zip_f);
+
+		auto view = zip_f.memory_view();
+		utki::assert(view.has_value(), SL);
+
+		std::string str(view.value().begin(), view.value().end());
+		utki::assert(str == "test file #2.\n", [&](auto&o){o << "str = " << str;}, SL);
+
+		// the data points into the zip file memory
+		utki::assert(view.value().data() >= zip_data.data(), SL);
+		utki::assert(view.value().data() + view.value().size() <= zip_data.data() + zip_data.size(), SL);
+
+		// seeking backwards is supported for such entries
+		std::array<uint8_t, 4> buf{};
+		utki::assert(zip_f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(zip_f.seek_forward(5) == 5, SL);
+		utki::assert(zip_f.seek_backward(7) == 7, SL);
+		utki::assert(zip_f.cur_pos() == 2, SL);
+		utki::assert(zip_f.read(utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(std::string(buf.begin(), buf.end()) == "st f", SL);
+
+		utki::assert(zip_f.read_at(10, utki::make_span(buf)) == buf.size(), SL);
+		utki::assert(std::string(buf.begin(), buf.end()) == "#2.\n", SL);
+	}
+
+	// stored entries of memory mapped zip file are accessed directly
+	{
+		papki::zip_file zip_f(std::make_unique<papki::mmap_file>("test.zip"), "test1.txt");
+
+		{
+			papki::file::guard file_guard(zip_f);
+
+			auto view = zip_f.memory_view();
+			utki::assert(view.has_value(), SL);
+			utki::assert(std::string(view.value().begin(), view.value().end()) == "test file #1\n", SL);
+		}
+
+		auto contents = zip_f.load();
+		utki::assert(std::string(contents.begin(), contents.end()) == "test file #1\n", SL);
+	}
+
+	// entries of zip file which is not in memory cannot be accessed directly
+	{
+		papki::zip_file zip_f(std::make_unique<papki::fs_file>("test.zip"), "test1.txt");
+
+		papki::file::guard file_guard(zip_f);
+
+		utki::assert(!zip_f.memory_view().has_value(), SL);
+	}
+
+	// deflated entries
+	{
+		// the big.txt entry consists of 36000 lines of such format
+		std::string expected;
+		for(size_t i = 0; i != 36000; ++i){
+			expected += "block " + std::to_string(i / 512) + ": ";
+			for(unsigned j = 0; j != 3; ++j){
+				expected += "papki zip_file test data. ";
+			}
+			expected += "\n";
+		}
+
+		papki::zip_file zip_f(std::make_unique<papki::fs_file>("test_deflated.zip"), "big.txt");
+
+		utki::assert(zip_f.size() == expected.size(), [&](auto&o){o << "zip_f.size() = " << zip_f.size();}, SL);
+		utki::assert(zip_f.compressed_size() < zip_f.size(), SL);
+
+		auto contents = zip_f.load();
+		utki::assert(std::string(contents.begin(), contents.end()) == expected, SL);
+
+		// load() from the archive residing in memory
+		{
+			auto archive_data = papki::fs_file("test_deflated.zip").load();
+			papki::zip_file mem_zip_f(std::make_unique<papki::span_file>(utki::make_span(archive_data)), "big.txt");
+			auto mem_contents = mem_zip_f.load();
+			utki::assert(mem_contents == contents, SL);
+
+			// partial load
+			mem_contents = mem_zip_f.load(100);
+			utki::assert(std::string(mem_contents.begin(), mem_contents.end()) == expected.substr(0, 100), SL);
+		}
+
+		// random access, the checkpoints recorded while reading are reused when the entry is opened again
+		{
+			papki::file::guard file_guard(zip_f);
+
+			std::array<char, 32> buf{};
+			auto check_read = [&](size_t pos){
+				utki::assert(zip_f.cur_pos() == pos, [&](auto&o){o << "cur_pos = " << zip_f.cur_pos() << ", pos = " << pos;}, SL);
+				auto num_read = zip_f.read(utki::to_uint8_t(utki::make_span(buf)));
+				utki::assert(num_read == buf.size(), SL);
+				utki::assert(std::string(buf.begin(), buf.end()) == expected.substr(pos, buf.size()), [&](auto&o){o << "pos = " << pos;}, SL);
+			};
+
+			utki::assert(zip_f.seek_forward(2'500'000) == 2'500'000, SL);
+			check_read(2'500'000);
+
+			utki::assert(zip_f.seek_backward(1'000'000) == 1'000'000, SL);
+			check_read(1'500'000 + buf.size());
+
+			utki::assert(zip_f.seek_backward(1'500'000) == 1'500'000, SL);
+			check_read(2 * buf.size());
+
+			utki::assert(zip_f.seek_forward(3'100'000) == 3'100'000, SL);
+			check_read(3'100'000 + 3 * buf.size());
+
+			zip_f.rewind();
+			check_read(0);
+
+			// read_at() does not change current position
+			std::array<char, 16> at_buf{};
+			utki::assert(zip_f.read_at(1'234'567, utki::to_uint8_t(utki::make_span(at_buf))) == at_buf.size(), SL);
+			utki::assert(std::string(at_buf.begin(), at_buf.end()) == expected.substr(1'234'567, at_buf.size()), SL);
+			check_read(buf.size());
+
+			// seeking beyond the end of entry stops at the end
+			auto num_skipped = zip_f.seek_forward(std::numeric_limits<size_t>::max());
+			utki::assert(num_skipped == expected.size() - 2 * buf.size(), [&](auto&o){o << "num_skipped = " << num_skipped;}, SL);
+			utki::assert(zip_f.read(utki::to_uint8_t(utki::make_span(buf))) == 0, SL);
+
+			utki::assert(zip_f.seek_backward(buf.size()) == buf.size(), SL);
+			check_read(expected.size() - buf.size());
+
+			// absolute seeking
+			utki::assert(zip_f.seek(2'000'000) == 2'000'000, SL);
+			check_read(2'000'000);
+
+			utki::assert(zip_f.seek(100) == 100, SL);
+			check_read(100);
+		}
+
+		zip_f.set_path("dir/small.txt");
+		contents = zip_f.load();
+		std::string small_expected;
+		for(unsigned i = 0; i != 4; ++i){
+			small_expected += "Hello from deflated zip entry!\n";
+		}
+		utki::assert(std::string(contents.begin(), contents.end()) == small_expected, SL);
+	}
+
+	// implicit directories, the test_deflated.zip has no entry for the 'dir/' directory
+	{
+		papki::zip_file zip_f(std::make_unique<papki::fs_file>("test_deflated.zip"), "./");
+
+		auto contents = zip_f.list_dir();
+		utki::assert(contents == std::vector<std::string>{"big.txt", "dir/"}, SL);
+
+		zip_f.set_path("dir/");
+		utki::assert(zip_f.exists(), SL);
+		contents = zip_f.list_dir();
+		utki::assert(contents == std::vector<std::string>{"small.txt"}, SL);
+
+		zip_f.set_path("non_existent_dir/");
+		utki::assert(!zip_f.exists(), SL);
+		utki::assert(zip_f.list_dir().empty(), SL);
+		auto entries = zip_f.dir_entries();
+		utki::assert(entries.begin() == entries.end(), SL);
+	}
+
+	// opening an archive reads only the central directory and the entry
+	{
+		std::vector<uint8_t> archive_data;
+		{
+			papki::zip_writer writer(std::make_unique<papki::vector_file>());
+			writer.add_entry("big.bin", std::vector<uint8_t>(4 * 1024 * 1024, 'a'), papki::zip_writer::method::store);
+			writer.add_entry("small.txt", utki::to_uint8_t(utki::make_span(std::string("small entry"))));
+			auto sink = writer.finish();
+			archive_data = dynamic_cast<papki::vector_file&>(*sink).reset_data();
+		}
+
+		std::atomic<size_t> num_bytes_read{0};
+
+		papki::zip_file zip_f(std::make_unique<read_counting_file>(utki::make_span(archive_data), num_bytes_read), "small.txt");
+		auto data = zip_f.load();
+		utki::assert(std::string(data.begin(), data.end()) == "small entry", SL);
+
+		// minizip searches for the end of central directory record within the last 64kb of the archive,
+		// twice, since it looks for ZIP64 record first, the rest of the archive is not read
+		utki::assert(num_bytes_read < 0x30000, [&](auto&o){o << "num_bytes_read = " << num_bytes_read;}, SL);
+
+		// spawned zip_file does not parse the archive again, it only reads the entry headers and data
+		num_bytes_read = 0;
+		auto spawned = zip_f.file::spawn("small.txt");
+		data = spawned->load();
+		utki::assert(std::string(data.begin(), data.end()) == "small entry", SL);
+		utki::assert(num_bytes_read < 0x100, [&](auto&o){o << "num_bytes_read = " << num_bytes_read;}, SL);
+
+		// spawned zip_file shares the directory
+		spawned->set_path("./");
+		utki::assert(spawned->list_dir() == std::vector<std::string>{"big.bin", "small.txt"}, SL);
+
+		// stored entry is served directly from the underlying memory
+		spawned->set_path("big.bin");
+		{
+			papki::file::guard file_guard(*spawned);
+			utki::assert(spawned->memory_view().has_value(), SL);
+			std::array<uint8_t, 4> buf{};
+			utki::assert(spawned->seek(1000) == 1000, SL);
+			utki::assert(spawned->read(utki::make_span(buf)) == buf.size(), SL);
+			utki::assert(buf == std::array<uint8_t, 4>{'a', 'a', 'a', 'a'}, SL);
+			utki::assert(spawned->read_at(4 * 1024 * 1024 - 2, utki::make_span(buf)) == 2, SL);
+		}
+	}
+
+	// inflate streams and buffers are reused across entries
+	{
+		std::vector<std::string> contents;
+		std::vector<uint8_t> archive_data;
+		{
+			papki::zip_writer writer(std::make_unique<papki::vector_file>());
+			for(unsigned i = 0; i != 10; ++i){
+				std::string content;
+				for(unsigned j = 0; j != (i + 1) * 1000; ++j){
+					content += std::to_string(i * j);
+				}
+				writer.add_entry(std::to_string(i) + ".txt", utki::to_uint8_t(utki::make_span(content)));
+				contents.push_back(std::move(content));
+			}
+			auto sink = writer.finish();
+			archive_data = dynamic_cast<papki::vector_file&>(*sink).reset_data();
+		}
+
+		papki::zip_file zip_f(std::make_unique<papki::span_file>(utki::make_span(archive_data)));
+		auto other = zip_f.spawn();
+
+		for(unsigned i = 0; i != contents.size(); ++i){
+			// entry is closed in the middle of inflating, its buffers are reused by the next entry
+			other->set_path(std::to_string((i + 1) % contents.size()) + ".txt");
+			papki::file::guard other_guard(*other);
+			std::array<uint8_t, 100> buf{};
+			utki::assert(other->read(utki::make_span(buf)) == buf.size(), SL);
+
+			// two entries are inflated at the same time
+			zip_f.set_path(std::to_string(i) + ".txt");
+			auto data = zip_f.load();
+			utki::assert(std::string(data.begin(), data.end()) == contents[i], SL);
+
+			utki::assert(other->read(utki::make_span(buf)) == buf.size(), SL);
+			const auto& expected = contents[(i + 1) % contents.size()];
+			utki::assert(std::equal(buf.begin(), buf.end(), std::next(expected.begin(), buf.size())), SL);
+		}
+
+		// same entry is opened again after its buffers were returned to the pool
+		zip_f.set_path("3.txt");
+		auto data = zip_f.load();
+		utki::assert(std::string(data.begin(), data.end()) == contents[3], SL);
+
+		// reading after loading the whole entry in one go
+		{
+			papki::file::guard file_guard(zip_f);
+			std::array<uint8_t, 100> buf{};
+			utki::assert(zip_f.seek(1000) == 1000, SL);
+			utki::assert(zip_f.read(utki::make_span(buf)) == buf.size(), SL);
+			utki::assert(std::equal(buf.begin(), buf.end(), std::next(contents[3].begin(), 1000)), SL);
+		}
+	}
+
+	// load() of empty and corrupted deflated entries
+	{
+		std::vector<uint8_t> archive_data;
+		{
+			papki::zip_writer writer(std::make_unique<papki::vector_file>());
+			writer.add_entry("empty.txt", {});
+			writer.add_entry("data.txt", utki::to_uint8_t(utki::make_span(std::string(1000, 'x'))));
+			auto sink = writer.finish();
+			archive_data = dynamic_cast<papki::vector_file&>(*sink).reset_data();
+		}
+
+		papki::zip_file zip_f(std::make_unique<papki::span_file>(utki::make_span(archive_data)), "empty.txt");
+		utki::assert(zip_f.load().empty(), SL);
+
+		zip_f.set_path("data.txt");
+		utki::assert(zip_f.load() == std::vector<uint8_t>(1000, 'x'), SL);
+
+		const std::string name = "data.txt";
+
+		// uncompressed size in the central directory which deflate cannot achieve is not allocated up front
+		{
+			auto bogus_data = archive_data;
+			auto central_name = std::find_end(bogus_data.begin(), bogus_data.end(), name.begin(), name.end());
+			utki::assert(central_name != bogus_data.end(), SL);
+			// uncompressed size field is at offset 24 of the 46 bytes long central directory header
+			auto size_field = std::prev(central_name, 46 - 24);
+			std::fill(size_field, std::next(size_field, 4), uint8_t(0xf0));
+
+			papki::zip_file bogus_f(std::make_unique<papki::span_file>(utki::make_span(bogus_data)), "data.txt");
+			utki::assert(bogus_f.size() == 0xf0f0f0f0, SL);
+			{
+				papki::file::guard file_guard(bogus_f);
+				utki::assert(!bogus_f.size_hint().has_value(), SL);
+			}
+
+			bool thrown = false;
+			try{
+				bogus_f.load();
+			}catch(std::runtime_error&){
+				thrown = true;
+			}
+			utki::assert(thrown, SL);
+		}
+
+		// corrupt the deflate block type, the compressed data follows the entry name in the local header
+		auto i = std::search(archive_data.begin(), archive_data.end(), name.begin(), name.end());
+		utki::assert(i != archive_data.end(), SL);
+		*std::next(i, ptrdiff_t(name.size())) ^= 0x4;
+
+		papki::zip_file corrupted_f(std::make_unique<papki::span_file>(utki::make_span(archive_data)), "data.txt");
+		bool thrown = false;
+		try{
+			corrupted_f.load();
+		}catch(std::runtime_error&){
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+	}
+
+	// custom inflate engine
+	{
+		auto archive_data = papki::fs_file("test_deflated.zip").load();
+		papki::zip_file zip_f(std::make_unique<papki::span_file>(utki::make_span(archive_data)), "dir/small.txt");
+		auto expected = zip_f.load();
+
+		auto engine = std::make_shared<counting_inflate_engine>();
+		zip_f.set_inflate_engine(engine);
+
+		utki::assert(zip_f.load() == expected, SL);
+		utki::assert(engine->num_calls == 1, SL);
+
+		// spawned objects use the same engine
+		auto loaded = zip_f.load_entries(std::vector<std::string>{"dir/small.txt", "big.txt"});
+		utki::assert(loaded.size() == 2, SL);
+		utki::assert(loaded[0] == expected, SL);
+		utki::assert(engine->num_calls == 3, SL);
+
+		// reading in pieces does not use the engine
+		{
+			papki::file::guard file_guard(zip_f);
+			std::array<uint8_t, 10> buf{};
+			utki::assert(zip_f.read(utki::make_span(buf)) == buf.size(), SL);
+		}
+		utki::assert(engine->num_calls == 3, SL);
+
+		// archive which is not in memory supplies the compressed data to the engine in pieces
+		{
+			papki::zip_file file_zip_f(std::make_unique<papki::fs_file>("test_deflated.zip"), "dir/small.txt");
+			file_zip_f.set_inflate_engine(engine);
+			utki::assert(file_zip_f.load() == expected, SL);
+			utki::assert(engine->num_calls == 4, SL);
+		}
+
+		// root_dir forwards load() to the wrapped zip_file
+		{
+			auto wrapped = std::make_unique<papki::zip_file>(
+				std::make_unique<papki::span_file>(utki::make_span(archive_data))
+			);
+			wrapped->set_inflate_engine(engine);
+			papki::root_dir root(std::move(wrapped), "dir/");
+			root.set_path("small.txt");
+			utki::assert(root.load() == expected, SL);
+			utki::assert(engine->num_calls == 5, SL);
+			utki::assert(!root.is_open(), SL);
+		}
+
+		bool thrown = false;
+		try{
+			zip_f.set_inflate_engine(nullptr);
+		}catch(std::invalid_argument&){
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+	}
+
+	// random access to big entry of poorly compressible data
+	{
+		// Random letters from a small alphabet are encoded with Huffman codes, but have almost no repetitions,
+		// so the entry is deflated into many blocks which mostly end in the middle of a byte.
+		// This makes the checkpoints recorded on block boundaries require priming the inflater with
+		// the remaining bits of the byte and setting the dictionary from the checkpoint window.
+		const size_t data_size = 6 * 1024 * 1024 + 12345;
+		std::vector<uint8_t> expected(data_size);
+		{
+			std::mt19937 gen(data_size);
+			for(auto& b : expected){
+				b = uint8_t('a' + gen() % 16);
+			}
+		}
+
+		std::vector<uint8_t> archive_data;
+		{
+			papki::zip_writer writer(std::make_unique<papki::vector_file>());
+			writer.add_entry("random.bin", expected);
+			writer.add_entry("stored.bin", expected, papki::zip_writer::method::store);
+			auto sink = writer.finish();
+			archive_data = dynamic_cast<papki::vector_file&>(*sink).reset_data();
+		}
+
+		std::vector<std::unique_ptr<papki::file>> archives;
+		archives.push_back(std::make_unique<papki::span_file>(utki::make_span(archive_data)));
+		archives.push_back(std::make_unique<no_read_at_file>(utki::make_span(archive_data)));
+
+		for(auto& archive : archives){
+			papki::zip_file zip_f(std::move(archive), "random.bin");
+			utki::assert(zip_f.compressed_size() > data_size / 2, SL);
+			utki::assert(zip_f.compressed_size() < data_size, SL);
+
+			for(const auto* path : {"random.bin", "stored.bin"}){
+				zip_f.set_path(path);
+				papki::file::guard file_guard(zip_f);
+
+				std::array<uint8_t, 1000> buf{};
+				auto check = [&](uint64_t pos, size_t num_bytes){
+					auto expected_num_bytes = size_t(std::min(uint64_t(num_bytes), data_size - std::min(pos, uint64_t(data_size))));
+					utki::assert(num_bytes == expected_num_bytes, [&](auto&o){o << "pos = " << pos << ", num_bytes = " << num_bytes;}, SL);
+					utki::assert(std::equal(buf.begin(), std::next(buf.begin(), ptrdiff_t(num_bytes)), std::next(expected.begin(), ptrdiff_t(pos))), [&](auto&o){o << "pos = " << pos;}, SL);
+				};
+
+				// reading till the end records the checkpoints
+				utki::assert(zip_f.seek_forward(data_size) == data_size, SL);
+
+				// seeking backward past the checkpoints restarts inflating from the checkpoints
+				for(uint64_t pos : {uint64_t(5'500'000), uint64_t(1'200'000), uint64_t(4'000'000), uint64_t(3'333'333), uint64_t(0)}){
+					utki::assert(zip_f.seek(pos) == pos, SL);
+					check(pos, zip_f.read(utki::make_span(buf)));
+				}
+
+				std::mt19937 gen(300);
+				for(unsigned i = 0; i != 300; ++i){
+					uint64_t pos = gen() % (data_size + 100);
+					if(i % 2 == 0){
+						utki::assert(zip_f.seek(pos) == std::min(pos, uint64_t(data_size)), SL);
+						check(pos, zip_f.read(utki::make_span(buf)));
+					}else{
+						auto cur_pos = zip_f.cur_pos();
+						check(pos, zip_f.read_at(pos, utki::make_span(buf)));
+						utki::assert(zip_f.cur_pos() == cur_pos, SL);
+					}
+				}
+
+				// concurrent positional reads
+				zip_f.rewind();
+				std::atomic<unsigned> num_failed{0};
+				std::vector<std::thread> threads;
+				for(unsigned t = 0; t != 4; ++t){
+					threads.emplace_back([&, t](){
+						std::mt19937 thread_gen(t);
+						std::array<uint8_t, 1000> thread_buf{};
+						for(unsigned i = 0; i != 20; ++i){
+							uint64_t pos = thread_gen() % (data_size - thread_buf.size());
+							auto num_bytes = zip_f.read_at(pos, utki::make_span(thread_buf));
+							if(num_bytes != thread_buf.size() || !std::equal(thread_buf.begin(), thread_buf.end(), std::next(expected.begin(), ptrdiff_t(pos)))){
+								++num_failed;
+							}
+						}
+					});
+				}
+				for(auto& thread : threads){
+					thread.join();
+				}
+				utki::assert(num_failed == 0, SL);
+				utki::assert(zip_f.cur_pos() == 0, SL);
+				check(0, zip_f.read(utki::make_span(buf)));
+			}
+		}
+	}
+
+	// entry names longer than 127 characters
+	{
+		const std::string long_dir = "long_" + std::string(200, 'd') + "/";
+		const std::string long_file = "long_" + std::string(300, 'f') + ".txt";
+
+		papki::zip_file zip_f(std::make_unique<papki::fs_file>("test_long_names.zip"), "./");
+
+		auto contents = zip_f.list_dir();
+		utki::assert(contents == std::vector<std::string>{long_dir}, SL);
+
+		zip_f.set_path(long_dir);
+		contents = zip_f.list_dir();
+		utki::assert(contents == std::vector<std::string>{long_file, "short.txt"}, SL);
+
+		zip_f.set_path(long_dir + long_file);
+		utki::assert(zip_f.exists(), SL);
+		auto data = zip_f.load();
+		utki::assert(std::string(data.begin(), data.end()) == "long name\n", SL);
+	}
 }
 }
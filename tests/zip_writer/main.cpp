@@ -0,0 +1,7 @@
+#include "tests.hpp"
+
+int main(int /* argc */, const char** /* argv */){
+	test_papki_zip_writer::run();
+
+	return 0;
+}
@@ -0,0 +1,247 @@
+#include <filesystem>
+
+#include <utki/debug.hpp>
+#include "../../src/papki/zip_writer.hpp"
+#include "../../src/papki/zip_file.hpp"
+#include "../../src/papki/fs_file.hpp"
+#include "../../src/papki/span_file.hpp"
+#include "../../src/papki/vector_file.hpp"
+
+#include "tests.hpp"
+
+namespace{
+std::string make_text(size_t num_lines){
+	std::string ret;
+	for(size_t i = 0; i != num_lines; ++i){
+		ret += "line " + std::to_string(i) + ": papki zip_writer test data\n";
+	}
+	return ret;
+}
+
+// memory file whose writes can be made to fail
+class failing_file : public papki::file{
+public:
+	std::vector<uint8_t> data;
+	bool fail = false;
+
+	std::unique_ptr<papki::file> spawn()override{
+		return std::make_unique<failing_file>();
+	}
+
+private:
+	void open_internal(papki::mode io_mode)override{}
+
+	void close_internal()const noexcept override{}
+
+	size_t write_internal(utki::span<const uint8_t> buf)override{
+		if(this->fail){
+			return 0;
+		}
+		this->data.insert(this->data.end(), buf.begin(), buf.end());
+		return buf.size();
+	}
+};
+
+void write_test_archive(papki::zip_writer& writer, const std::string& text){
+	writer.add_entry("stored.txt", utki::to_uint8_t(utki::make_span(text)), papki::zip_writer::method::store);
+	writer.add_entry("dir/", {});
+	writer.add_entry("dir/deflated.txt", utki::to_uint8_t(utki::make_span(text)));
+
+	// streamed entry in implicit directory
+	writer.begin_entry("implicit/streamed.txt");
+	for(size_t pos = 0; pos < text.size(); pos += 1000){
+		writer.write(utki::to_uint8_t(utki::make_span(text).subspan(pos, std::min(size_t(1000), text.size() - pos))));
+	}
+	writer.end_entry();
+
+	writer.add_entry("empty.txt", {});
+}
+
+void check_test_archive(std::unique_ptr<papki::file> archive, const std::string& text){
+	papki::zip_file zip_f(std::move(archive), "./");
+
+	{
+		auto contents = zip_f.list_dir();
+		std::vector<std::string> expected = {"stored.txt", "dir/", "implicit/", "empty.txt"};
+		utki::assert(contents == expected, [&](auto&o){
+			for(const auto& c : contents){
+				o << c << ' ';
+			}
+		}, SL);
+	}
+
+	zip_f.set_path("dir/");
+	utki::assert(zip_f.list_dir() == std::vector<std::string>{"deflated.txt"}, SL);
+
+	for(const auto& path : {"stored.txt", "dir/deflated.txt", "implicit/streamed.txt"}){
+		zip_f.set_path(path);
+		auto data = zip_f.load();
+		utki::assert(std::string(data.begin(), data.end()) == text, [&](auto&o){o << "path = " << path;}, SL);
+	}
+
+	zip_f.set_path("stored.txt");
+	utki::assert(zip_f.compressed_size() == text.size(), SL);
+
+	zip_f.set_path("dir/deflated.txt");
+	utki::assert(zip_f.compressed_size() < text.size() / 2, SL);
+
+	zip_f.set_path("empty.txt");
+	utki::assert(zip_f.size() == 0, SL);
+	utki::assert(zip_f.load().empty(), SL);
+}
+}
+
+namespace test_papki_zip_writer{
+void run(){
+	const auto text = make_text(10000);
+
+	// write archive to memory
+	{
+		papki::zip_writer writer(std::make_unique<papki::vector_file>());
+		write_test_archive(writer, text);
+		auto archive = writer.finish();
+
+		check_test_archive(std::move(archive), text);
+	}
+
+	// write archive to file system
+	{
+		const std::string file_name = "zip_writer_test.zip";
+		{
+			papki::zip_writer writer(std::make_unique<papki::fs_file>(file_name), 9);
+			write_test_archive(writer, text);
+			writer.finish();
+		}
+
+		check_test_archive(std::make_unique<papki::fs_file>(file_name), text);
+
+		std::filesystem::remove(file_name);
+	}
+
+	// archive is finished by destructor
+	{
+		const std::string file_name = "zip_writer_test_unfinished.zip";
+		{
+			papki::zip_writer writer(std::make_unique<papki::fs_file>(file_name));
+			writer.begin_entry("stored.txt", papki::zip_writer::method::store);
+			writer.write(utki::to_uint8_t(utki::make_span(text)));
+		}
+
+		papki::zip_file zip_f(std::make_unique<papki::fs_file>(file_name), "stored.txt");
+		auto data = zip_f.load();
+		utki::assert(std::string(data.begin(), data.end()) == text, SL);
+
+		std::filesystem::remove(file_name);
+	}
+
+	// whole stored entry has CRC and sizes in the local header and no data descriptor
+	{
+		papki::zip_writer writer(std::make_unique<papki::vector_file>());
+		writer.add_entry("stored.txt", utki::to_uint8_t(utki::make_span(text)), papki::zip_writer::method::store);
+		auto archive = writer.finish();
+		auto data = dynamic_cast<papki::vector_file&>(*archive).reset_data();
+
+		auto read_32 = [&](size_t pos){
+			return uint32_t(data[pos]) | (uint32_t(data[pos + 1]) << 8) | (uint32_t(data[pos + 2]) << 16) | (uint32_t(data[pos + 3]) << 24);
+		};
+
+		// general purpose flags are at offset 6 of the local header, bit 3 means data descriptor
+		utki::assert((data[6] & 0x8) == 0, SL);
+		utki::assert(read_32(14) != 0, SL); // crc
+		utki::assert(read_32(18) == text.size(), SL); // compressed size
+		utki::assert(read_32(22) == text.size(), SL); // uncompressed size
+
+		// data descriptor would follow the 30 bytes long local header, the name and the data
+		auto central_header_pos = 30 + std::string("stored.txt").size() + text.size();
+		utki::assert(read_32(central_header_pos) == 0x02014b50, SL);
+
+		papki::zip_file zip_f(std::make_unique<papki::span_file>(utki::make_span(data)), "stored.txt");
+		auto loaded = zip_f.load();
+		utki::assert(std::string(loaded.begin(), loaded.end()) == text, SL);
+	}
+
+	// entry whose local header could not be written does not get into the central directory
+	{
+		auto sink = std::make_unique<failing_file>();
+		auto& f = *sink;
+		papki::zip_writer writer(std::move(sink));
+		writer.add_entry("a.txt", utki::to_uint8_t(utki::make_span(text)));
+
+		f.fail = true;
+		bool thrown = false;
+		try{
+			writer.begin_entry("b.txt");
+		}catch(std::runtime_error&){
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+		f.fail = false;
+
+		writer.add_entry("c.txt", utki::to_uint8_t(utki::make_span(text)));
+		writer.finish();
+
+		papki::zip_file zip_f(std::make_unique<papki::span_file>(utki::make_span(f.data)), "./");
+		utki::assert(zip_f.list_dir() == std::vector<std::string>{"a.txt", "c.txt"}, SL);
+	}
+
+	// number of entries is limited, 0xffff entries means ZIP64
+	{
+		papki::zip_writer writer(std::make_unique<papki::vector_file>());
+		for(size_t i = 0; i != 0xfffe; ++i){
+			writer.add_entry(std::to_string(i) + "/", {});
+		}
+
+		bool thrown = false;
+		try{
+			writer.begin_entry("last/");
+		}catch(std::runtime_error&){
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+
+		auto archive = writer.finish();
+		papki::zip_file zip_f(std::move(archive), "./");
+		utki::assert(zip_f.list_dir().size() == 0xfffe, SL);
+	}
+
+	// usage errors
+	{
+		papki::zip_writer writer(std::make_unique<papki::vector_file>());
+
+		bool thrown = false;
+		try{
+			writer.write(utki::to_uint8_t(utki::make_span(text)));
+		}catch(std::logic_error&){
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+
+		writer.begin_entry("dir/");
+		thrown = false;
+		try{
+			writer.write(utki::to_uint8_t(utki::make_span(text)));
+		}catch(std::logic_error&){
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+
+		thrown = false;
+		try{
+			writer.begin_entry("/absolute.txt");
+		}catch(std::logic_error&){
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+
+		writer.finish();
+
+		thrown = false;
+		try{
+			writer.begin_entry("late.txt");
+		}catch(std::logic_error&){
+			thrown = true;
+		}
+		utki::assert(thrown, SL);
+	}
+}
+}
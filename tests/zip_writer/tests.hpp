@@ -0,0 +1,6 @@
+#pragma once
+
+
+namespace test_papki_zip_writer{
+void run();
+}